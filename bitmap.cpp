@@ -0,0 +1,33 @@
+#include "bitmap.hpp"
+#include "mem.hpp"
+#include <bit>
+#include <stdexcept>
+#include <string>
+
+namespace uwc {
+
+    ShortWords::ShortWords( unsigned maxLength ) : maxLength_( maxLength ) {
+        if ( maxLength == 0 || maxLength > kMaxLength )
+            throw std::invalid_argument(
+                "Bad short word length " + std::to_string( maxLength ) + ", should be in range 1 .. "
+                + std::to_string( kMaxLength ) );
+        words_ = ( offsets[ maxLength + 1 ] + 63 ) / 64;
+        // fresh mapping is zeroed
+        bits_ = static_cast< std::atomic< std::uint64_t >* >( util::allocLarge( bytes() ) );
+    }
+
+    ShortWords::~ShortWords() { util::freeLarge( bits_, bytes() ); }
+
+    std::size_t ShortWords::count() const {
+        std::size_t res = 0;
+        for ( std::size_t i = 0; i < words_; ++i )
+            res += static_cast< std::size_t >( std::popcount( bits_[ i ].load( std::memory_order_relaxed ) ) );
+        return res;
+    }
+
+    void ShortWords::clear() {
+        for ( std::size_t i = 0; i < words_; ++i )
+            bits_[ i ].store( 0, std::memory_order_relaxed );
+    }
+
+} // namespace uwc
@@ -0,0 +1,97 @@
+#ifndef BITMAP_HPP
+#define BITMAP_HPP
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace uwc {
+
+    // Set of short words of letters 'a'..'z' shared by all workers: one bit per possible word at perfect index
+    // (number of shorter words + letters as base 26 number), 1.5MB for words up to 5 letters, 40MB up to 6.
+    // Inserting is a relaxed fetch_or (skipped when bit is set already), no hashing, no merging.
+    class ShortWords {
+      public:
+        static constexpr unsigned kMaxLength = 6;
+
+        // throws std::invalid_argument if maxLength is 0 or more than kMaxLength
+        explicit ShortWords( unsigned maxLength );
+        ~ShortWords();
+        ShortWords( ShortWords const& ) = delete;
+        ShortWords& operator=( ShortWords const& ) = delete;
+
+        // false if word is not short word of 'a'..'z', caller has to keep it elsewhere
+        bool insert( std::string_view word ) {
+            std::size_t idx;
+            if ( !index( word, idx ) )
+                return false;
+            auto& bits = bits_[ idx >> 6 ];
+            std::uint64_t mask = std::uint64_t( 1 ) << ( idx & 63 );
+            if ( !( bits.load( std::memory_order_relaxed ) & mask ) ) // frequent words do not write shared cache line
+                bits.fetch_or( mask, std::memory_order_relaxed );
+            return true;
+        }
+        bool contains( std::string_view word ) const {
+            std::size_t idx;
+            return index( word, idx ) && ( bits_[ idx >> 6 ].load( std::memory_order_relaxed ) >> ( idx & 63 ) & 1 );
+        }
+
+        // call f( std::string_view ) for all words by length and alphabetically for each length,
+        // view is valid only during the call
+        template< typename F >
+        void forEach( F&& f ) const {
+            char word[ kMaxLength ];
+            std::size_t len = 1;
+            for ( std::size_t i = 0; i < words_; ++i ) {
+                for ( auto bits = bits_[ i ].load( std::memory_order_relaxed ); bits != 0; bits &= bits - 1 ) {
+                    std::size_t idx = i * 64 + static_cast< std::size_t >( std::countr_zero( bits ) );
+                    while ( idx >= offsets[ len + 1 ] )
+                        ++len;
+                    std::size_t value = idx - offsets[ len ];
+                    for ( std::size_t pos = len; pos-- > 0; value /= 26 )
+                        word[ pos ] = static_cast< char >( 'a' + value % 26 );
+                    f( std::string_view( word, len ) );
+                }
+            }
+        }
+
+        std::size_t count() const; // popcount of bitmap, call when no thread inserts
+        void clear();
+        unsigned maxLength() const { return maxLength_; }
+        std::size_t bytes() const { return words_ * sizeof( std::uint64_t ); }
+
+      private:
+        // number of words shorter than index
+        static constexpr std::array< std::size_t, kMaxLength + 2 > offsets = [] {
+            std::array< std::size_t, kMaxLength + 2 > res{};
+            std::size_t words = 26;
+            for ( std::size_t len = 1; len + 1 < res.size(); ++len, words *= 26 )
+                res[ len + 1 ] = res[ len ] + words;
+            return res;
+        }();
+
+        unsigned maxLength_;
+        std::size_t words_; // bitmap size in 64 bit words
+        std::atomic< std::uint64_t >* bits_;
+
+        bool index( std::string_view word, std::size_t& idx ) const {
+            if ( word.empty() || word.size() > maxLength_ )
+                return false;
+            std::size_t value = 0;
+            for ( char c : word ) {
+                unsigned code = static_cast< unsigned char >( c ) - 'a';
+                if ( code > 25 )
+                    return false;
+                value = value * 26 + code;
+            }
+            idx = offsets[ word.size() ] + value;
+            return true;
+        }
+    };
+
+} // namespace uwc
+
+#endif
@@ -0,0 +1,30 @@
+#include "counter.hpp"
+
+namespace uwc {
+
+    template class Counter< HashEngine, agg::Single >;
+    template class Counter< HashEngine, agg::Multi >;
+    template class Counter< HashEngine, agg::DelayedSingle >;
+    template class Counter< HashEngine, agg::DelayedMulti >;
+    template class Counter< HashEngine, agg::Single, util::SpaceDelimiters >;
+    template class Counter< HashEngine, agg::Multi, util::SpaceDelimiters >;
+    template class Counter< HashEngine, agg::DelayedSingle, util::SpaceDelimiters >;
+    template class Counter< HashEngine, agg::DelayedMulti, util::SpaceDelimiters >;
+    template class Counter< FlatEngine, agg::Single >;
+    template class Counter< FlatEngine, agg::Multi >;
+    template class Counter< FlatEngine, agg::DelayedSingle >;
+    template class Counter< FlatEngine, agg::DelayedMulti >;
+    template class Counter< FlatEngine, agg::Single, util::SpaceDelimiters >;
+    template class Counter< FlatEngine, agg::Multi, util::SpaceDelimiters >;
+    template class Counter< FlatEngine, agg::DelayedSingle, util::SpaceDelimiters >;
+    template class Counter< FlatEngine, agg::DelayedMulti, util::SpaceDelimiters >;
+    template class Counter< SortEngine, agg::Single >;
+    template class Counter< SortEngine, agg::Multi >;
+    template class Counter< SortEngine, agg::DelayedSingle >;
+    template class Counter< SortEngine, agg::DelayedMulti >;
+    template class Counter< SortEngine, agg::Single, util::SpaceDelimiters >;
+    template class Counter< SortEngine, agg::Multi, util::SpaceDelimiters >;
+    template class Counter< SortEngine, agg::DelayedSingle, util::SpaceDelimiters >;
+    template class Counter< SortEngine, agg::DelayedMulti, util::SpaceDelimiters >;
+
+} // namespace uwc
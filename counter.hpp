@@ -0,0 +1,1006 @@
+#ifndef COUNTER_HPP
+#define COUNTER_HPP
+
+#include "bitmap.hpp"
+#include "flat.hpp"
+#include "hash.hpp"
+#include "input.hpp"
+#include "mem.hpp"
+#include "perf.hpp"
+#include "sketch.hpp"
+#include "sorted.hpp"
+#include "tokenizer.hpp"
+#include "util.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <unordered_set>
+#include <vector>
+
+namespace uwc {
+
+    namespace detail {
+// #define Logging 1
+#ifdef Logging
+        inline std::mutex logMutex_;
+        template< typename... ARGS >
+        void log( ARGS const&... args ) {
+            std::unique_lock lock( logMutex_ );
+            // std::cout << std::this_thread::get_id() << ": ";
+            ( std::cout << ... << args ) << std::endl;
+        }
+#else
+        template< typename... ARGS >
+        void log( ARGS const&... ) {}
+#endif
+    } // namespace detail
+
+    // to enable heterogenous lookup by string_view or const char*, Hash - hash policy (hash.hpp)
+    template< typename Hash >
+    struct basic_string_hash {
+        using is_transparent = void;
+        [[nodiscard]] size_t operator()( const char* txt ) const { return Hash::hash( txt ); }
+        [[nodiscard]] size_t operator()( std::string_view txt ) const { return Hash::hash( txt ); }
+        template< typename Alloc >
+        [[nodiscard]] size_t operator()( std::basic_string< char, std::char_traits< char >, Alloc > const& txt ) const {
+            return Hash::hash( txt );
+        }
+    };
+    using string_hash = basic_string_hash< hash::Std >;
+
+    // nodes and strings come from util::Arena when huge pages are enabled
+    using Word = std::basic_string< char, std::char_traits< char >, util::ArenaAllocator< char > >;
+    template< typename Hash >
+    using BasicWords = std::unordered_set< Word, basic_string_hash< Hash >, std::equal_to<>, util::ArenaAllocator< Word > >;
+    using Words = BasicWords< hash::Std >;
+
+    const auto npos = std::string_view::npos;
+
+    // engine = set implementation used by workers and for final result
+    // filter - workers skip words already present in final set
+    // Hash - hash policy (hash.hpp)
+    template< typename Hash = hash::Std >
+    struct BasicHashEngine {
+        using Set = BasicWords< Hash >;
+        static constexpr char const* name = "hash";
+        static constexpr char const* hashName = Hash::name;
+        static constexpr bool filter = true;
+    };
+    using HashEngine = BasicHashEngine<>;
+    // open addressing, words are inserted in prefetched batches (flat.hpp)
+    template< typename Hash = hash::Wy >
+    struct BasicFlatEngine {
+        using Set = FlatSet< Hash >;
+        static constexpr char const* name = "flat";
+        static constexpr char const* hashName = Hash::name;
+        static constexpr bool filter = true;
+    };
+    using FlatEngine = BasicFlatEngine<>;
+    // packed keys appended to vectors, duplicates removed by radix sort (sorted.hpp)
+    struct SortEngine {
+        using Set = SortedWords;
+        static constexpr char const* name = "sort";
+        static constexpr char const* hashName = "none";
+        static constexpr bool filter = false;
+    };
+
+    // aggregation policies: when and where worker sets are merged into final set
+    namespace agg {
+        struct Single {
+            static constexpr bool delayed = false;
+            static constexpr bool parallel = false;
+            static constexpr char const* description = "Aggregate in single thread";
+        };
+        struct Multi {
+            static constexpr bool delayed = false;
+            static constexpr bool parallel = true;
+            static constexpr char const* description = "Aggregate in multiple threads";
+        };
+        struct DelayedSingle {
+            static constexpr bool delayed = true;
+            static constexpr bool parallel = false;
+            static constexpr char const* description = "Aggregate in single thread after processing all data";
+        };
+        struct DelayedMulti {
+            static constexpr bool delayed = true;
+            static constexpr bool parallel = true;
+            static constexpr char const* description = "Aggregate in multiple threads after processing all data";
+        };
+    } // namespace agg
+
+    // number of workers which finished their task, waiting thread sleeps instead of polling
+    class DoneCounter {
+      public:
+        void reset() {
+            std::unique_lock lock( m_ );
+            count_ = 0;
+        }
+        void add() {
+            std::unique_lock lock( m_ );
+            ++count_;
+            cv_.notify_one();
+        }
+        void waitFor( std::size_t expected ) {
+            std::unique_lock lock( m_ );
+            while ( count_ < expected )
+                cv_.wait( lock );
+        }
+
+      private:
+        std::size_t count_ = 0;
+        std::mutex m_;
+        std::condition_variable cv_;
+    };
+
+    // set taking precomputed hash, so slots of several words can be prefetched before they are probed
+    template< typename Set >
+    concept Prefetching = requires( Set& set, std::string_view word, std::uint64_t hash ) {
+        { Set::hash( word ) } -> std::convertible_to< std::uint64_t >;
+        set.prefetch( hash );
+        set.emplace( word, hash );
+        { set.contains( word, hash ) } -> std::convertible_to< bool >;
+    };
+
+    // set keeping unsorted words until compact() (SortedWords): sorting is done by merges, so it is always merged
+    // pairwise by workers whatever the aggregation, and it is compacted before it is read
+    template< typename Set >
+    concept Compacting = requires( Set& set ) { set.compact(); };
+
+    // phases of counting measured in perf mode
+    enum Phase { ReadPhase, TokenizePhase, InsertPhase, MergePhase, kPhases };
+    inline constexpr std::array< char const*, kPhases > kPhaseNames = { "read", "tokenize", "insert", "merge" };
+    using PhaseCounts = std::array< util::PerfCounts, kPhases >;
+
+    // read only view of complete set of words of other counter (with its short words), probed in probe mode
+    template< typename Set >
+    struct Reference {
+        Set const* words;
+        ShortWords const* shortWords = nullptr;
+    };
+
+    // Words of reference found by probing counter: one bit per position of word in reference set and short words
+    // in own bitmap, all shared by workers, so found words are only marked, not copied to sets of probing counter.
+    template< typename Set >
+    class ReferenceHits {
+      public:
+        explicit ReferenceHits( Reference< Set > const& reference )
+            : reference_( reference ), bits_( ( positions( *reference.words ) + 63 ) / 64 ) {
+            if ( reference.shortWords )
+                shortWords_ = std::make_unique< ShortWords >( reference.shortWords->maxLength() );
+        }
+
+        Reference< Set > const& reference() const { return reference_; }
+
+        // false if reference does not contain word
+        bool mark( std::string_view word ) {
+            if ( markShort( word ) )
+                return true;
+            if constexpr ( requires { reference_.words->position( word ); } )
+                return markPosition( reference_.words->position( word ) );
+            else
+                return markPosition( bucketPosition( *reference_.words, word ) );
+        }
+        bool mark( std::string_view word, std::uint64_t hash )
+            requires Prefetching< Set >
+        {
+            return markShort( word ) || markPosition( reference_.words->position( word, hash ) );
+        }
+
+        std::size_t count() const { // call when no thread marks
+            std::size_t res = shortWords_ ? shortWords_->count() : 0;
+            for ( auto const& bits : bits_ )
+                res += static_cast< std::size_t >( std::popcount( bits.load( std::memory_order_relaxed ) ) );
+            return res;
+        }
+        void clear() {
+            for ( auto& bits : bits_ )
+                bits.store( 0, std::memory_order_relaxed );
+            if ( shortWords_ )
+                shortWords_->clear();
+        }
+
+      private:
+        Reference< Set > reference_;
+        std::vector< std::atomic< std::uint64_t > > bits_;
+        std::unique_ptr< ShortWords > shortWords_;
+
+        static std::size_t positions( Set const& words ) {
+            if constexpr ( requires { words.positions(); } )
+                return words.positions();
+            else
+                return bucketPositions( words );
+        }
+        bool markShort( std::string_view word ) {
+            return shortWords_ && reference_.shortWords->contains( word ) && shortWords_->insert( word );
+        }
+        bool markPosition( std::size_t pos ) {
+            if ( pos == npos )
+                return false;
+            auto& bits = bits_[ pos >> 6 ];
+            std::uint64_t mask = std::uint64_t( 1 ) << ( pos & 63 );
+            if ( !( bits.load( std::memory_order_relaxed ) & mask ) ) // frequent words do not write shared cache line
+                bits.fetch_or( mask, std::memory_order_relaxed );
+            return true;
+        }
+    };
+
+    template< typename Engine, typename Delims >
+    class Worker {
+      public:
+        using Set = typename Engine::Set;
+
+        explicit Worker( int id, Set const& final, DoneCounter& done )
+            : id_( id ), done_( done ), finalWords_( final ), thread_( &Worker::process, this ) {}
+        ~Worker() {
+            // detail::log( "~worker()", id_ );
+            stop();
+        }
+        void stop() {
+            {
+                std::unique_lock lock( m_ );
+                state_ = Exit;
+                cv_.notify_one();
+            }
+            thread_.join();
+            detail::log( id_, ": Worker stopped." );
+        }
+
+        void run( std::string_view input, bool clear ) {
+            std::unique_lock lock( m_ );
+            if ( clear )
+                words_.clear();
+            data_ = input;
+            range_.reset();
+            mergeWith_ = nullptr;
+            if ( data_.empty() ) {
+                state_ = Done;
+                done_.add();
+            } else {
+                state_ = Go;
+                cv_.notify_one();
+            }
+        }
+
+        // read words starting in [ begin, end ) of file by blocks of blockSize bytes, word crossing the end is completed
+        // by reading on, file must stay valid till worker is done
+        void runRange( util::PositionalFile const& file, std::size_t begin, std::size_t end, std::size_t blockSize,
+                       bool clear ) {
+            std::unique_lock lock( m_ );
+            if ( clear )
+                words_.clear();
+            data_ = {};
+            range_ = Range{ &file, begin, end, blockSize };
+            mergeWith_ = nullptr;
+            error_ = nullptr;
+            state_ = Go;
+            cv_.notify_one();
+        }
+        // rethrow exception of last runRange(), call when worker is done
+        void checkError() {
+            if ( auto error = std::exchange( error_, nullptr ) )
+                std::rethrow_exception( error );
+        }
+
+        Set const& getWords() const {
+            assert( state_ == Done );
+            return words_;
+        }
+
+        Set& useWords() { return words_; }
+        util::WordStats& stats() { return stats_; } // accumulated over runs, read when worker is done
+        void useShortWords( ShortWords* shortWords ) { shortWords_ = shortWords; } // call when worker is idle
+        // words of reference are only marked, missing ones are added to sketch if precision > 0, call when idle
+        void useReference( ReferenceHits< Set >* reference, unsigned sketchPrecision ) {
+            reference_ = reference;
+            sketch_.reset();
+            if ( reference && sketchPrecision > 0 )
+                sketch_ = std::make_unique< Sketch >( sketchPrecision );
+        }
+        Sketch* sketch() { return sketch_.get(); } // accumulated over runs, read when worker is done
+        // all words are added to segment sketch if precision > 0, call when idle
+        void useSegments( unsigned precision ) {
+            segment_.reset();
+            if ( precision > 0 )
+                segment_ = std::make_unique< Sketch >( precision );
+        }
+        Sketch* segment() { return segment_.get(); } // read and cleared by counter when worker is done
+        // perf mode: tokenizing and inserting run as separate passes measured by counters of worker thread
+        void usePerf( bool enable ) {
+            perf_ = enable;
+            perfCounts_ = {};
+        }
+        PhaseCounts& perfCounts() { return perfCounts_; } // accumulated over runs, read when worker is done
+
+        void mergeWith( Worker& other ) {
+            std::unique_lock lock( m_ );
+            mergeWith_ = &other;
+            state_ = Go;
+            cv_.notify_one();
+        }
+        int id() const { return id_; }
+
+      private:
+        bool goOrExit() const { return state_ == Go || state_ == Exit; }
+        void process() {
+            detail::log( id_, ": Worker wait for data" );
+            { // wait for data
+                std::unique_lock lock( m_ );
+                while ( !goOrExit() )
+                    cv_.wait( lock );
+                if ( state_ == Exit ) {
+                    detail::log( id_, ": Worker process() exit" );
+                    return;
+                }
+            }
+            while ( true ) {
+                if ( perf_ && !perfCounters_ )
+                    perfCounters_ = std::make_unique< util::PerfCounters >(); // counts calling thread
+                util::PerfCounters const* counters = perf_ ? perfCounters_.get() : nullptr;
+                if ( mergeWith_ ) {
+                    detail::log( id_, ": Merge ", mergeWith_->id_, " into ", id_ );
+                    util::PerfScope scope( counters, perfCounts_[ MergePhase ] );
+                    words_.merge( mergeWith_->words_ );
+                } else if ( range_ ) {
+                    try {
+                        readRange( counters );
+                    } catch ( ... ) {
+                        error_ = std::current_exception();
+                    }
+                } else
+                    processData( counters );
+
+                std::unique_lock lock( m_ );
+                state_ = Done;
+                // signal under lock, otherwise next run() could be overwritten by state_ = Done above
+                done_.add();
+                // wait for next chunk or exit
+                while ( !goOrExit() )
+                    cv_.wait( lock );
+                if ( state_ == Exit ) {
+                    detail::log( id_, ": Worker process() exit" );
+                    return;
+                }
+            }
+        }
+
+        // probe mode: word of reference is marked, other word only goes to sketch
+        bool probed( std::string_view word ) {
+            if ( !reference_ )
+                return false;
+            if ( !reference_->mark( word ) && sketch_ )
+                sketch_->add( word );
+            return true;
+        }
+
+        // tokenize data_ (ends with delimiter or is complete) and insert words
+        void processData( util::PerfCounters const* counters ) {
+            if ( counters ) {
+                tokens_.clear();
+                {
+                    util::PerfScope scope( counters, perfCounts_[ TokenizePhase ] );
+                    util::forEachWord< Delims >( data_, stats_,
+                                                 [ this ]( std::string_view word ) { tokens_.push_back( word ); } );
+                }
+                util::PerfScope scope( counters, perfCounts_[ InsertPhase ] );
+                insertWords( [ this ]( auto&& f ) {
+                    for ( auto word : tokens_ )
+                        f( word );
+                } );
+            } else
+                insertWords( [ this ]( auto&& f ) { util::forEachWord< Delims >( data_, stats_, f ); } );
+        }
+
+        // Read range_ by blocks to own buffer and process complete words of each block, partial word at the end of
+        // block is moved to the begining of buffer (which grows if the word fills it). Word crossing the begining of
+        // range belongs to previous range and is skipped, word crossing the end is completed by small reads past it.
+        void readRange( util::PerfCounters const* counters ) {
+            static constexpr std::size_t kFinishRead = 4096; // past the end of range
+            auto [ file, pos, end, blockSize ] = *range_;
+            if ( !block_ || block_->size() < blockSize )
+                block_ = std::make_unique< util::Buffer >( blockSize ); // allocated and touched by this thread
+            else if ( block_->valid() > 0 )
+                block_->reset();
+            auto read = [ &, file = file ]( char* dst, std::size_t size, std::size_t offset ) {
+                util::PerfScope scope( counters, perfCounts_[ ReadPhase ] );
+                return file->read( dst, size, offset );
+            };
+            bool skip = false;
+            if ( pos > 0 ) {
+                char before;
+                skip = read( &before, 1, pos - 1 ) == 1 && !Delims::is( before );
+            }
+            while ( true ) {
+                if ( block_->storageSize() == 0 ) { // partial word fills whole buffer
+                    auto bigger = std::make_unique< util::Buffer >( block_->size() * 2 );
+                    bigger->append( block_->view() );
+                    block_ = std::move( bigger );
+                }
+                bool finishing = pos >= end; // only word crossing the end is left
+                auto size = std::min( block_->storageSize(), finishing ? kFinishRead : end - pos );
+                auto n = read( block_->storageStart(), size, pos );
+                pos += n;
+                block_->addValid( n );
+                bool last = n < size; // end of file
+                auto data = block_->view();
+                if ( skip ) {
+                    auto idx = util::findFirstDelimiter< Delims >( data );
+                    if ( idx == npos ) {
+                        if ( block_->valid() > 0 )
+                            block_->reset();
+                        if ( last || pos >= end )
+                            return;
+                        continue;
+                    }
+                    data.remove_prefix( idx );
+                    skip = false;
+                }
+                std::size_t keep = 0;
+                if ( finishing && !last ) {
+                    auto idx = util::findFirstDelimiter< Delims >( data );
+                    if ( idx != npos ) {
+                        data = data.substr( 0, idx );
+                        last = true;
+                    } else
+                        keep = data.size();
+                } else if ( !last ) {
+                    auto idx = util::findLastDelimiter< Delims >( data );
+                    keep = idx == npos ? data.size() : data.size() - idx - 1;
+                }
+                data_ = data.substr( 0, data.size() - keep );
+                if ( !data_.empty() )
+                    processData( counters );
+                if ( last || ( keep == 0 && pos >= end ) )
+                    return;
+                if ( keep < block_->valid() )
+                    block_->reset( keep );
+            }
+        }
+
+        // insert words given by forEach( f ), which calls f( std::string_view ) for each of them
+        // Only Prefetching sets (FlatSet) go by batches: std::unordered_set of hash engine cannot take a hash computed
+        // ahead and its bucket() builds the key type, SortedWords appends keys without probing.
+        template< typename ForEach >
+        void insertWords( ForEach&& forEach ) {
+            if constexpr ( Prefetching< Set > ) {
+                insertBatched( forEach );
+            } else {
+                forEach( [ this ]( std::string_view word ) {
+                    if ( segment_ )
+                        segment_->add( word );
+                    if ( probed( word ) )
+                        return;
+                    if ( shortWords_ && shortWords_->insert( word ) )
+                        return;
+                    if constexpr ( Engine::filter ) {
+                        if ( finalWords_.contains( lookupKey< Set >( word ) ) )
+                            return;
+                    }
+                    words_.emplace( word ); // put word into set
+                } );
+            }
+        }
+
+        // Tokenize kBatch words, hash them and prefetch their slots in final and own set, then probe and insert,
+        // so cache misses of the whole batch overlap instead of stalling on every word.
+        // In probe mode only slots of reference set are prefetched, words are marked there instead of inserted.
+        template< typename ForEach >
+        void insertBatched( ForEach&& forEach ) {
+            static constexpr std::size_t kBatch = 16;
+            std::array< std::string_view, kBatch > words;
+            std::array< std::uint64_t, kBatch > hashes;
+            std::size_t count = 0;
+            auto insert = [ & ] {
+                for ( std::size_t i = 0; i < count; ++i ) {
+                    hashes[ i ] = Set::hash( words[ i ] );
+                    if ( reference_ ) {
+                        reference_->reference().words->prefetch( hashes[ i ] );
+                        continue;
+                    }
+                    if constexpr ( Engine::filter )
+                        finalWords_.prefetch( hashes[ i ] );
+                    words_.prefetch( hashes[ i ] );
+                }
+                for ( std::size_t i = 0; i < count; ++i ) {
+                    if ( segment_ ) {
+                        if constexpr ( std::is_same_v< Set, FlatSet< hash::Wy > > )
+                            segment_->addHash( hashes[ i ] ); // same hash function
+                        else
+                            segment_->add( words[ i ] );
+                    }
+                    if ( reference_ ) {
+                        if ( !reference_->mark( words[ i ], hashes[ i ] ) && sketch_ )
+                            sketch_->add( words[ i ] );
+                        continue;
+                    }
+                    if constexpr ( Engine::filter ) {
+                        if ( finalWords_.contains( words[ i ], hashes[ i ] ) )
+                            continue;
+                    }
+                    words_.emplace( words[ i ], hashes[ i ] );
+                }
+                count = 0;
+            };
+            forEach( [ & ]( std::string_view word ) {
+                if ( !reference_ && shortWords_ && shortWords_->insert( word ) ) {
+                    if ( segment_ )
+                        segment_->add( word );
+                    return;
+                }
+                words[ count++ ] = word;
+                if ( count == kBatch )
+                    insert();
+            } );
+            insert();
+        }
+
+        [[maybe_unused]] int id_; // used in logging only
+        DoneCounter& done_;
+        Set const& finalWords_;
+
+        enum State { Wait, Go, Done, Exit };
+        State state_ = Wait;
+
+        std::string_view data_;
+        ShortWords* shortWords_ = nullptr; // shared by all workers, optional
+        ReferenceHits< Set >* reference_ = nullptr;
+        std::unique_ptr< Sketch > sketch_;
+        std::unique_ptr< Sketch > segment_;
+        bool perf_ = false;
+        std::unique_ptr< util::PerfCounters > perfCounters_; // opened by worker thread
+        PhaseCounts perfCounts_;
+        std::vector< std::string_view > tokens_; // of chunk in perf mode
+        struct Range {
+            util::PositionalFile const* file;
+            std::size_t begin, end, blockSize;
+        };
+        std::optional< Range > range_;
+        std::unique_ptr< util::Buffer > block_; // read buffer of range
+        std::exception_ptr error_;              // of reading range
+        Set words_;
+        util::WordStats stats_;
+        mutable std::mutex m_;
+        mutable std::condition_variable cv_;
+
+        Worker* mergeWith_ = nullptr;
+        std::thread thread_; // last, thread uses all members above
+    };
+
+    // estimated distinct words of part of input in segment mode
+    struct Segment {
+        std::size_t offset = 0; // in data fed
+        std::size_t size = 0;
+        double distinct = 0;   // of this segment
+        double cumulative = 0; // of all segments so far
+    };
+
+    // Counts unique words in data fed in any number of pieces, words may be split between pieces.
+    // Owns pool of worker threads, each piece is split to chunks processed in parallel.
+    // Delims - words delimiters, util::Delimiters<...>
+    template< typename Engine = HashEngine, typename Aggregation = agg::DelayedSingle,
+              typename Delims = util::WhitespaceDelimiters >
+    class Counter {
+      public:
+        using Set = typename Engine::Set;
+        using Worker = uwc::Worker< Engine, Delims >;
+
+        static constexpr std::size_t kDefaultInBufSize = 256 * util::kMB;
+        static constexpr std::size_t kMaxRangeBlock = 4 * util::kMB; // read by worker at once, still cached when tokenized
+
+        // threads == 0 -> hardware_concurrency() + 1
+        // inBufSize - size of read buffer used by feedFile()/feedInput(), allocated on first use
+        explicit Counter( unsigned threads = 0, std::size_t inBufSize = kDefaultInBufSize ) : inBufSize_( inBufSize ) {
+            if ( threads == 0 )
+                threads = std::thread::hardware_concurrency() + 1;
+            detail::log( "Cores: ", threads );
+            workers_.reserve( threads );
+            for ( unsigned i = 0; i < threads; ++i )
+                workers_.emplace_back( new Worker( i, final_, doneCounter_ ) );
+        }
+        ~Counter() { workers_.clear(); } // stop and join worker threads before sets are destroyed
+
+        Counter( Counter const& ) = delete;
+        Counter& operator=( Counter const& ) = delete;
+
+        // Process data without copying it, data must stay valid till return.
+        // Partial word at the end is kept and joined with begining of next call.
+        void feed( std::string_view data ) {
+            fed_ += data.size();
+            if ( !carry_.empty() ) {
+                auto idx = util::findFirstDelimiter< Delims >( data );
+                carry_.append( data.substr( 0, idx ) );
+                if ( idx == npos )
+                    return;
+                data.remove_prefix( idx );
+                flush();
+            }
+            auto last = util::findLastDelimiter< Delims >( data );
+            if ( last == npos ) {
+                carry_.assign( data );
+                return;
+            }
+            carry_.assign( data.substr( last + 1 ) );
+            data.remove_suffix( data.size() - last - 1 );
+            process( data );
+        }
+
+        // Process whole input, end of input ends the last word.
+        void feedInput( util::Input& input ) {
+            if ( !buf_ )
+                buf_ = std::make_unique< util::Buffer >( inBufSize_ );
+            [[maybe_unused]] std::size_t round = 0;
+            detail::log( "Read buffer size: ", buf_->size() );
+            while ( !input.eof() ) {
+                detail::log( "Read input (round ", round++, ")..." );
+                // rounds end at segment ends, full segment ends when data of the next one comes
+                bool full = segmentSize_ > 0 && fed_ - segmentStart_ >= segmentSize_;
+                auto size = buf_->storageSize();
+                if ( segmentSize_ > 0 )
+                    size = std::min( size, full ? segmentSize_ : segmentStart_ + segmentSize_ - fed_ );
+                {
+                    util::PerfScope scope( perfCounters_.get(), perfCounts_[ ReadPhase ] );
+                    buf_->addValid( input.read( buf_->storageStart(), size ) );
+                }
+                if ( full && buf_->valid() > 0 )
+                    endSegment();
+                if ( buf_->valid() > 0 ) {
+                    feed( buf_->view() );
+                    buf_->reset();
+                }
+            }
+            flush();
+            if ( segmentSize_ > 0 && fed_ > segmentStart_ )
+                endSegment();
+        }
+
+        // throws std::runtime_error if file cannot be opened or decoded
+        void feedFile( std::filesystem::path const& path ) {
+            auto input = util::openInput( path, static_cast< unsigned >( workers_.size() ) - 1 );
+            feedInput( *input );
+        }
+
+        // Process plain file read by workers in parallel: file is split to a byte range per worker, each worker reads
+        // its range in blocks (up to inBufSize / threads bytes) by positional reads and processes them, no reads nor
+        // rounds are coordinated. Word crossing the end of range is completed by worker of the range it starts in.
+        // Pending partial word of feed() is complete before the file, end of file ends the last word.
+        // throws std::runtime_error if file cannot be read, std::invalid_argument if it is compressed,
+        // std::logic_error in segment mode (segments need sequential input)
+        void feedFileRanges( std::filesystem::path const& path ) {
+            if ( segmentSize_ > 0 )
+                throw std::logic_error( "Segment mode needs sequential input" );
+            if ( util::detectCompression( path ) != util::Compression::None )
+                throw std::invalid_argument( "Compressed input cannot be read by ranges" );
+            util::PositionalFile file( path );
+            flush();
+            auto size = file.size();
+            fed_ += size;
+            if ( size == 0 )
+                return;
+            auto ranges = std::min< std::size_t >( workers_.size(), size );
+            auto blockSize = std::clamp< std::size_t >( inBufSize_ / ranges, 1, kMaxRangeBlock );
+            doneCounter_.reset();
+            std::vector< Worker* > toMerge;
+            for ( std::size_t i = 0; i < ranges; ++i ) {
+                workers_[ i ]->runRange( file, size * i / ranges, size * ( i + 1 ) / ranges, blockSize, !Aggregation::delayed );
+                toMerge.push_back( workers_[ i ].get() );
+            }
+            detail::log( "wait for workers reading ", ranges, " ranges" );
+            doneCounter_.waitFor( ranges );
+            for ( auto w : toMerge )
+                w->checkError();
+            if constexpr ( !Aggregation::delayed )
+                aggregate( toMerge );
+        }
+
+        // Finish fed data (pending partial word is complete) and return number of unique words.
+        // More data can be fed afterwards.
+        std::size_t count() {
+            flush();
+            if constexpr ( Aggregation::delayed ) {
+                detail::log( "Delayed Merge start" );
+                std::vector< Worker* > toMerge;
+                for ( auto& w : workers_ )
+                    toMerge.push_back( w.get() );
+                aggregate( toMerge );
+                detail::log( "Delayed Merge done" );
+            }
+            if constexpr ( Compacting< Set > )
+                final_.compact(); // words of carry, set of single worker
+            if ( reference_ )
+                return reference_->count();
+            return final_.size() + ( shortWords_ ? shortWords_->count() : 0 );
+        }
+
+        // prepare for words unique words, allocate read buffer
+        void reserve( std::size_t words ) {
+            final_.reserve( words );
+            for ( auto& w : workers_ )
+                w->useWords().reserve( words );
+            if ( !buf_ )
+                buf_ = std::make_unique< util::Buffer >( inBufSize_ );
+        }
+
+        // Words of up to maxLength letters 'a'..'z' go to bitmap shared by workers instead of sets (0 disables).
+        // Forgets words fed so far, throws std::invalid_argument if maxLength > ShortWords::kMaxLength.
+        void useShortWords( unsigned maxLength ) {
+            reset();
+            shortWords_.reset();
+            if ( maxLength > 0 )
+                shortWords_ = std::make_unique< ShortWords >( maxLength );
+            for ( auto& w : workers_ )
+                w->useShortWords( shortWords_.get() );
+        }
+
+        // Probe mode: only words contained in reference are counted by marking them (ReferenceHits), other words are
+        // added to sketch (when sketchPrecision > 0) and forgotten, so memory stays proportional to reference.
+        // Reference has to stay complete and unchanged while words are fed, e.g. reference() of other counter after
+        // its count(). std::nullopt ends probe mode. Forgets words fed so far.
+        void useReference( std::optional< Reference< Set > > reference, unsigned sketchPrecision = Sketch::kDefaultPrecision ) {
+            reset();
+            reference_.reset();
+            if ( reference )
+                reference_ = std::make_unique< ReferenceHits< Set > >( *reference );
+            sketch_.reset();
+            if ( reference_ && sketchPrecision > 0 )
+                sketch_.emplace( sketchPrecision );
+            for ( auto& w : workers_ )
+                w->useReference( reference_.get(), sketchPrecision );
+        }
+        Reference< Set > reference() const { return { &final_, shortWords_.get() }; } // complete after count()
+
+        // estimate of distinct words rejected in probe mode so far, throws std::logic_error if there is no sketch
+        Sketch sketch() const {
+            if ( !sketch_ )
+                throw std::logic_error( "Counter has no sketch" );
+            Sketch res = *sketch_;
+            for ( auto& w : workers_ )
+                res.merge( *w->sketch() );
+            return res;
+        }
+
+        // Segment mode: distinct words of consecutive segments of input are estimated in the same pass by sketches
+        // of workers (all words are hashed once more, no sets are added). feedInput() ends segment every segmentSize
+        // bytes of (decompressed) input, word crossing the end belongs to the next segment; endSegment() ends it
+        // explicitly. segmentSize 0 disables segment mode. Forgets words fed so far.
+        void useSegments( std::size_t segmentSize, unsigned precision = Sketch::kDefaultPrecision ) {
+            reset();
+            segmentSize_ = segmentSize;
+            segment_.reset();
+            segmentsUnion_.reset();
+            if ( segmentSize > 0 ) {
+                segment_.emplace( precision );
+                segmentsUnion_.emplace( precision );
+            }
+            for ( auto& w : workers_ )
+                w->useSegments( segmentSize > 0 ? precision : 0 );
+        }
+
+        // end current segment (pending partial word goes to the next one) and return it
+        // throws std::logic_error if not in segment mode
+        Segment const& endSegment() {
+            if ( !segment_ )
+                throw std::logic_error( "Counter is not in segment mode" );
+            Sketch sketch = *segment_;
+            segment_->clear();
+            for ( auto& w : workers_ ) {
+                sketch.merge( *w->segment() );
+                w->segment()->clear();
+            }
+            segmentsUnion_->merge( sketch );
+            segments_.push_back( { segmentStart_, fed_ - segmentStart_, sketch.estimate(), segmentsUnion_->estimate() } );
+            segmentStart_ = fed_;
+            return segments_.back();
+        }
+        std::vector< Segment > const& segments() const { return segments_; }
+
+        // Perf mode: hardware counters and time of phases, read and final merge are measured on the calling thread
+        // (call from the thread which feeds data), tokenizing, inserting and merging on worker threads. Workers
+        // tokenize each chunk to a vector before inserting the words, so both passes can be measured.
+        void usePerf( bool enable ) {
+            perfCounters_.reset();
+            if ( enable )
+                perfCounters_ = std::make_unique< util::PerfCounters >();
+            perfCounts_ = {};
+            for ( auto& w : workers_ )
+                w->usePerf( enable );
+        }
+        util::PerfCounters const* perfCounters() const { return perfCounters_.get(); } // of calling thread
+        // counts summed over threads, after count()
+        PhaseCounts perfCounts() const {
+            PhaseCounts res = perfCounts_;
+            for ( auto& w : workers_ )
+                for ( std::size_t i = 0; i < res.size(); ++i )
+                    res[ i ] += w->perfCounts()[ i ];
+            return res;
+        }
+
+        // complete word (e.g. from saved word list) goes directly to final set
+        void add( std::string_view word ) {
+            ++stats_.total;
+            stats_.add( word.size() );
+            if ( segment_ )
+                segment_->add( word );
+            insert( word );
+        }
+
+        // forget all words, threads and allocated buffers are kept
+        void reset() {
+            if ( shortWords_ )
+                shortWords_->clear();
+            if ( reference_ )
+                reference_->clear();
+            if ( sketch_ )
+                sketch_->clear();
+            if ( segment_ ) {
+                segment_->clear();
+                segmentsUnion_->clear();
+            }
+            segments_.clear();
+            fed_ = segmentStart_ = 0;
+            perfCounts_ = {};
+            final_.clear();
+            for ( auto& w : workers_ ) {
+                w->useWords().clear();
+                w->stats() = {};
+                if ( auto sketch = w->sketch() )
+                    sketch->clear();
+                if ( auto segment = w->segment() )
+                    segment->clear();
+                w->perfCounts() = {};
+            }
+            carry_.clear();
+            stats_ = {};
+        }
+
+        Set const& words() const { return final_; } // complete after count(), without words kept by shortWords()
+        ShortWords const* shortWords() const { return shortWords_.get(); }
+
+        // call f( std::string_view ) for all unique words (after count()), views are valid only during the call
+        template< typename F >
+        void forEachWord( F&& f ) const {
+            if constexpr ( requires { final_.forEach( f ); } )
+                final_.forEach( f );
+            else
+                for ( auto const& word : final_ )
+                    f( std::string_view( word ) );
+            if ( shortWords_ )
+                shortWords_->forEach( f );
+        }
+
+        // total words and their lengths fed so far (pending partial word is counted by count())
+        util::WordStats stats() const {
+            util::WordStats res = stats_;
+            for ( auto& w : workers_ )
+                res.merge( w->stats() );
+            return res;
+        }
+        unsigned threads() const { return static_cast< unsigned >( workers_.size() ); }
+
+      private:
+        std::size_t inBufSize_;
+        std::unique_ptr< util::Buffer > buf_;
+        std::string carry_; // partial word from previous feed()
+        Set final_;
+        std::unique_ptr< ShortWords > shortWords_;
+        std::unique_ptr< ReferenceHits< Set > > reference_;
+        std::optional< Sketch > sketch_; // of rejected words completed by flush()
+        std::size_t fed_ = 0;            // bytes passed to feed()
+        std::size_t segmentSize_ = 0;
+        std::size_t segmentStart_ = 0;
+        std::optional< Sketch > segment_;       // of words of current segment completed by flush()
+        std::optional< Sketch > segmentsUnion_; // of all segments
+        std::vector< Segment > segments_;
+        std::unique_ptr< util::PerfCounters > perfCounters_;
+        PhaseCounts perfCounts_;
+        util::WordStats stats_; // of words completed by flush()
+        DoneCounter doneCounter_;
+        std::vector< std::unique_ptr< Worker > > workers_;
+
+        // pending partial word goes directly to final set
+        void flush() {
+            if ( !carry_.empty() ) {
+                add( carry_ );
+                carry_.clear();
+            }
+        }
+
+        void insert( std::string_view word ) {
+            if ( reference_ ) {
+                if ( !reference_->mark( word ) && sketch_ )
+                    sketch_->add( word );
+                return;
+            }
+            if ( !shortWords_ || !shortWords_->insert( word ) )
+                final_.emplace( word );
+        }
+
+        // data ends with delimiter (or is complete)
+        void process( std::string_view data ) {
+            auto chunks = util::splitToChunks< Delims >( data, static_cast< unsigned >( workers_.size() ) );
+            doneCounter_.reset();
+            std::vector< Worker* > toMerge;
+            std::size_t usedWorkers = chunks.size();
+            for ( std::size_t i = 0; i < usedWorkers; ++i ) {
+                workers_[ i ]->run( chunks[ i ], !Aggregation::delayed );
+                toMerge.push_back( workers_[ i ].get() );
+            }
+            detail::log( "wait for workers ", usedWorkers );
+            doneCounter_.waitFor( usedWorkers );
+            if constexpr ( !Aggregation::delayed )
+                aggregate( toMerge );
+        }
+
+        // merge sets of given workers into final set
+        void aggregate( std::vector< Worker* >& toMerge ) {
+            if constexpr ( Aggregation::parallel || Compacting< Set > ) {
+                // pairwise in multiple threads
+                while ( toMerge.size() > 1 ) {
+                    auto first = toMerge.begin();
+                    auto last = --toMerge.end();
+                    doneCounter_.reset();
+                    std::size_t expected = 0;
+                    while ( first < last ) {
+                        ( *first )->mergeWith( **last );
+                        ++first;
+                        --last;
+                        ++expected;
+                    }
+                    detail::log( "wait for ", expected, " workers" );
+                    doneCounter_.waitFor( expected );
+                    toMerge.erase( std::prev( toMerge.end(), expected ), toMerge.end() );
+                }
+            }
+            util::PerfScope scope( perfCounters_.get(), perfCounts_[ MergePhase ] );
+            for ( auto w : toMerge ) {
+                detail::log( "Merge ", w->id(), " into final set" );
+                if ( final_.empty() )
+                    std::swap( final_, w->useWords() );
+                else
+                    final_.merge( w->useWords() );
+            }
+        }
+    };
+
+    extern template class Counter< HashEngine, agg::Single >;
+    extern template class Counter< HashEngine, agg::Multi >;
+    extern template class Counter< HashEngine, agg::DelayedSingle >;
+    extern template class Counter< HashEngine, agg::DelayedMulti >;
+    extern template class Counter< HashEngine, agg::Single, util::SpaceDelimiters >;
+    extern template class Counter< HashEngine, agg::Multi, util::SpaceDelimiters >;
+    extern template class Counter< HashEngine, agg::DelayedSingle, util::SpaceDelimiters >;
+    extern template class Counter< HashEngine, agg::DelayedMulti, util::SpaceDelimiters >;
+    extern template class Counter< FlatEngine, agg::Single >;
+    extern template class Counter< FlatEngine, agg::Multi >;
+    extern template class Counter< FlatEngine, agg::DelayedSingle >;
+    extern template class Counter< FlatEngine, agg::DelayedMulti >;
+    extern template class Counter< FlatEngine, agg::Single, util::SpaceDelimiters >;
+    extern template class Counter< FlatEngine, agg::Multi, util::SpaceDelimiters >;
+    extern template class Counter< FlatEngine, agg::DelayedSingle, util::SpaceDelimiters >;
+    extern template class Counter< FlatEngine, agg::DelayedMulti, util::SpaceDelimiters >;
+    extern template class Counter< SortEngine, agg::Single >;
+    extern template class Counter< SortEngine, agg::Multi >;
+    extern template class Counter< SortEngine, agg::DelayedSingle >;
+    extern template class Counter< SortEngine, agg::DelayedMulti >;
+    extern template class Counter< SortEngine, agg::Single, util::SpaceDelimiters >;
+    extern template class Counter< SortEngine, agg::Multi, util::SpaceDelimiters >;
+    extern template class Counter< SortEngine, agg::DelayedSingle, util::SpaceDelimiters >;
+    extern template class Counter< SortEngine, agg::DelayedMulti, util::SpaceDelimiters >;
+
+} // namespace uwc
+
+#endif
@@ -0,0 +1,127 @@
+#include "dump.hpp"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace uwc {
+
+    namespace {
+        const std::size_t kIndexReadSize = 4 * util::kMB;
+    }
+
+    WordDump::WordDump( std::filesystem::path const& path, bool sorted, unsigned threads )
+        : out_( path ), sorted_( sorted ), threads_( std::max( 1u, threads ) ) {}
+
+    void WordDump::beginRun() {
+        inRun_ = true;
+        if ( sorted_ )
+            runs_.emplace_back();
+    }
+
+    std::string_view WordDump::copy( std::string_view word ) {
+        if ( chunkFree_ < word.size() ) {
+            std::size_t size = std::max( kChunkSize, word.size() );
+            chunks_.emplace_back( new char[ size ] );
+            chunkNext_ = chunks_.back().get();
+            chunkFree_ = size;
+        }
+        char* ptr = chunkNext_;
+        std::memcpy( ptr, word.data(), word.size() );
+        chunkNext_ += word.size();
+        chunkFree_ -= word.size();
+        return { ptr, word.size() };
+    }
+
+    std::size_t WordDump::finish() {
+        if ( sorted_ ) {
+            // partitions of unsorted words are sorted in parallel, each becomes a run of merge
+            std::size_t parts = std::clamp< std::size_t >( unsorted_.size() / kMinPartition, 1, threads_ );
+            auto bound = [ & ]( std::size_t part ) { return unsorted_.data() + unsorted_.size() * part / parts; };
+            auto sortPart = [ & ]( std::size_t part ) { std::sort( bound( part ), bound( part + 1 ) ); };
+            std::vector< std::thread > threads;
+            for ( std::size_t i = 1; i < parts; ++i )
+                threads.emplace_back( sortPart, i );
+            sortPart( 0 );
+            for ( auto& thread : threads )
+                thread.join();
+
+            std::vector< std::pair< std::string_view const*, std::string_view const* > > ranges;
+            for ( std::size_t i = 0; i < parts; ++i )
+                ranges.emplace_back( bound( i ), bound( i + 1 ) );
+            for ( auto const& run : runs_ )
+                ranges.emplace_back( run.data(), run.data() + run.size() );
+            merge( std::move( ranges ) );
+        }
+        out_.close();
+        return count_;
+    }
+
+    void WordDump::merge( std::vector< std::pair< std::string_view const*, std::string_view const* > > ranges ) {
+        std::erase_if( ranges, []( auto const& range ) { return range.first == range.second; } );
+        // binary heap of ranges by their first word, smallest on top
+        auto greater = []( auto const& a, auto const& b ) { return *b.first < *a.first; };
+        std::make_heap( ranges.begin(), ranges.end(), greater );
+        while ( ranges.size() > 1 ) {
+            std::pop_heap( ranges.begin(), ranges.end(), greater );
+            auto& range = ranges.back();
+            out_.writeLine( *range.first++ );
+            if ( range.first == range.second )
+                ranges.pop_back();
+            else
+                std::push_heap( ranges.begin(), ranges.end(), greater );
+        }
+        if ( !ranges.empty() )
+            for ( auto word = ranges[ 0 ].first; word != ranges[ 0 ].second; ++word )
+                out_.writeLine( *word );
+    }
+
+    void addWords( WordDump& dump, SortedWords const& words ) {
+        char word[ kMaxPacked ];
+        dump.beginRun();
+        for ( Key key : words.keys() )
+            dump.addTemporary( { word, unpack( key, word ) } );
+        dump.endRun();
+        for ( auto const& other : words.others() )
+            dump.add( other );
+    }
+
+    void addWords( WordDump& dump, ShortWords const& words ) {
+        // every length is a run
+        std::size_t length = 0;
+        words.forEach( [ & ]( std::string_view word ) {
+            if ( word.size() != length ) {
+                dump.endRun();
+                dump.beginRun();
+                length = word.size();
+            }
+            dump.addTemporary( word );
+        } );
+        dump.endRun();
+    }
+
+    void readIndex( std::filesystem::path const& path, std::function< void( std::string_view ) > const& f ) {
+        auto input = util::openInput( path, 1 );
+        std::string buf( kIndexReadSize, 0 );
+        std::string carry; // partial line of previous read
+        while ( !input->eof() ) {
+            std::string_view data( buf.data(), input->read( buf.data(), buf.size() ) );
+            for ( auto eol = data.find( '\n' ); eol != std::string_view::npos; eol = data.find( '\n' ) ) {
+                auto line = data.substr( 0, eol );
+                if ( !carry.empty() ) {
+                    carry.append( line );
+                    line = carry;
+                }
+                if ( !line.empty() )
+                    f( line );
+                carry.clear();
+                data.remove_prefix( eol + 1 );
+            }
+            carry.append( data );
+        }
+        if ( !carry.empty() )
+            f( carry );
+    }
+
+} // namespace uwc
@@ -0,0 +1,103 @@
+#ifndef DUMP_HPP
+#define DUMP_HPP
+
+#include "bitmap.hpp"
+#include "counter.hpp"
+#include "flat.hpp"
+#include "output.hpp"
+#include "sorted.hpp"
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace uwc {
+
+    // Writes words to file, one per line. Unsorted dump copies words from set storage straight to the output buffer.
+    // Sorted dump collects views of words (only temporary words are copied, to chunks owned by the dump), sorts
+    // partitions of them in parallel threads and merges sorted partitions with runs given in order already.
+    // Words are ordered by bytes, as by LC_ALL=C sort.
+    class WordDump {
+      public:
+        // throws std::runtime_error if file cannot be created
+        WordDump( std::filesystem::path const& path, bool sorted, unsigned threads );
+
+        // word has to stay valid until finish()
+        void add( std::string_view word ) {
+            ++count_;
+            if ( !sorted_ )
+                out_.writeLine( word );
+            else if ( inRun_ )
+                runs_.back().push_back( word );
+            else
+                unsorted_.push_back( word );
+        }
+        // word is valid only during the call
+        void addTemporary( std::string_view word ) { add( sorted_ ? copy( word ) : word ); }
+
+        // words added between beginRun() and endRun() come in ascending order, they are not sorted again
+        void beginRun();
+        void endRun() { inRun_ = false; }
+
+        // sort and write collected words, close file, return number of words written
+        std::size_t finish();
+
+      private:
+        static constexpr std::size_t kChunkSize = util::kMB;
+        static constexpr std::size_t kMinPartition = 64 * 1024; // words sorted by one thread at least
+
+        util::Output out_;
+        bool sorted_;
+        unsigned threads_;
+        std::size_t count_ = 0;
+        bool inRun_ = false;
+        std::vector< std::string_view > unsorted_;
+        std::vector< std::vector< std::string_view > > runs_;
+        std::vector< std::unique_ptr< char[] > > chunks_; // storage of temporary words
+        char* chunkNext_ = nullptr;
+        std::size_t chunkFree_ = 0;
+
+        std::string_view copy( std::string_view word );
+        void merge( std::vector< std::pair< std::string_view const*, std::string_view const* > > ranges );
+    };
+
+    template< typename Hash >
+    void addWords( WordDump& dump, BasicWords< Hash > const& words ) {
+        for ( auto const& word : words )
+            dump.add( word );
+    }
+    template< typename Hash >
+    void addWords( WordDump& dump, FlatSet< Hash > const& words ) {
+        words.forEach( [ & ]( std::string_view word ) { dump.add( word ); } );
+    }
+    void addWords( WordDump& dump, SortedWords const& words );
+    void addWords( WordDump& dump, ShortWords const& words );
+
+    // write unique words fed to counter to path, optionally sorted, return number of words written
+    // throws std::runtime_error if file cannot be written
+    template< typename Engine, typename Aggregation, typename Delims >
+    std::size_t dumpWords( Counter< Engine, Aggregation, Delims >& counter, std::filesystem::path const& path, bool sorted ) {
+        counter.count(); // completes final set
+        WordDump dump( path, sorted, counter.threads() );
+        addWords( dump, counter.words() );
+        if ( auto bitmap = counter.shortWords() )
+            addWords( dump, *bitmap );
+        return dump.finish();
+    }
+
+    // call f for words of index file (one word per line, as written by dumpWords()), plain or compressed
+    // throws std::runtime_error if file cannot be read
+    void readIndex( std::filesystem::path const& path, std::function< void( std::string_view ) > const& f );
+
+    // words of index file are added to counter as complete words
+    template< typename Engine, typename Aggregation, typename Delims >
+    void loadIndex( Counter< Engine, Aggregation, Delims >& counter, std::filesystem::path const& path ) {
+        readIndex( path, [ & ]( std::string_view word ) { counter.add( word ); } );
+    }
+
+} // namespace uwc
+
+#endif
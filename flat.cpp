@@ -0,0 +1,119 @@
+#include "flat.hpp"
+#include <algorithm>
+#include <bit>
+
+namespace uwc {
+
+    namespace {
+        const std::size_t kMergeBatch = 16; // slots prefetched ahead when merging
+    }
+
+    template< typename Hash >
+    void FlatSet< Hash >::storeLong( Slot& slot, std::string_view word ) {
+        if ( chunkFree_ < word.size() ) {
+            std::size_t size = std::max( kChunkSize, word.size() );
+            chunks_.emplace_back( new char[ size ] );
+            chunkNext_ = chunks_.back().get();
+            chunkFree_ = size;
+        }
+        char* ptr = chunkNext_;
+        std::memcpy( ptr, word.data(), word.size() );
+        chunkNext_ += word.size();
+        chunkFree_ -= word.size();
+
+        slot.size = Slot::kLong;
+        std::size_t len = word.size();
+        std::memcpy( slot.data, &ptr, sizeof( ptr ) );
+        std::memcpy( slot.data + sizeof( ptr ), &len, sizeof( len ) );
+    }
+
+    template< typename Hash >
+    void FlatSet< Hash >::grow() { rehash( std::max( kMinSlots, slots_.size() * 2 ) ); }
+
+    template< typename Hash >
+    void FlatSet< Hash >::rehash( std::size_t slots ) {
+        decltype( slots_ ) old( slots );
+        std::swap( old, slots_ );
+        mask_ = slots - 1;
+        shift_ = 64 - static_cast< unsigned >( std::countr_zero( slots ) );
+        growAt_ = slots / 4 * 3;
+        // stored hashes are reused, long words stay where they are
+        for ( auto const& slot : old ) {
+            if ( slot.hash == 0 )
+                continue;
+            std::size_t i = index( slot.hash );
+            while ( slots_[ i ].hash != 0 )
+                i = ( i + 1 ) & mask_;
+            slots_[ i ] = slot;
+        }
+    }
+
+    template< typename Hash >
+    void FlatSet< Hash >::reserve( std::size_t words ) {
+        std::size_t slots = std::bit_ceil( std::max( kMinSlots, words / 3 * 4 + 1 ) );
+        if ( slots > slots_.size() )
+            rehash( slots );
+    }
+
+    template< typename Hash >
+    void FlatSet< Hash >::merge( FlatSet& other ) {
+        if ( other.empty() )
+            return;
+        if ( empty() && other.slots_.size() >= slots_.size() ) {
+            std::swap( *this, other );
+            other.clear();
+            return;
+        }
+        reserve( size_ + other.size_ );
+        // long words keep their storage, chunks of other are taken over
+        for ( auto& chunk : other.chunks_ )
+            chunks_.push_back( std::move( chunk ) );
+        other.chunks_.clear();
+        other.chunkFree_ = 0;
+
+        // prefetch slots for next words while inserting current ones
+        Slot const* pending[ kMergeBatch ];
+        std::size_t count = 0;
+        auto insert = [ this ]( Slot const& from ) {
+            for ( std::size_t i = index( from.hash );; i = ( i + 1 ) & mask_ ) {
+                auto& slot = slots_[ i ];
+                if ( slot.hash == 0 ) {
+                    slot = from;
+                    ++size_;
+                    return;
+                }
+                if ( slot.hash == from.hash && slot.view() == from.view() )
+                    return;
+            }
+        };
+        for ( auto const& slot : other.slots_ ) {
+            if ( slot.hash == 0 )
+                continue;
+            prefetch( slot.hash );
+            pending[ count++ ] = &slot;
+            if ( count == kMergeBatch ) {
+                for ( std::size_t i = 0; i < count; ++i )
+                    insert( *pending[ i ] );
+                count = 0;
+            }
+        }
+        for ( std::size_t i = 0; i < count; ++i )
+            insert( *pending[ i ] );
+        other.clear();
+    }
+
+    template< typename Hash >
+    void FlatSet< Hash >::clear() {
+        if ( size_ > 0 )
+            std::fill( slots_.begin(), slots_.end(), Slot{} );
+        size_ = 0;
+        chunks_.clear();
+        chunkFree_ = 0;
+    }
+
+    template class FlatSet< hash::Std >;
+    template class FlatSet< hash::Wy >;
+    template class FlatSet< hash::Crc32c >;
+    template class FlatSet< hash::Packed >;
+
+} // namespace uwc
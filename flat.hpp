@@ -0,0 +1,142 @@
+#ifndef FLAT_HPP
+#define FLAT_HPP
+
+#include "hash.hpp"
+#include "mem.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace uwc {
+
+    // Open addressing set of words for flat engine: 32 byte slots with full hash, words up to 23 chars
+    // are stored in the slot, longer ones in chunks owned by the set. Linear probing from slot given
+    // by top bits of fibonacci hashing, so index of a word is known before the slot is touched and
+    // callers can prefetch it (hash() + prefetch() + emplace( word, hash ) in batches).
+    // Hash - hash policy (hash.hpp)
+    template< typename Hash >
+    class FlatSet {
+      public:
+        static std::uint64_t hash( std::string_view word ) {
+            std::uint64_t h = Hash::hash( word );
+            return h ? h : 1; // 0 marks empty slot
+        }
+
+        void prefetch( std::uint64_t hash ) const {
+            if ( !slots_.empty() )
+                __builtin_prefetch( &slots_[ index( hash ) ] );
+        }
+
+        bool contains( std::string_view word ) const { return contains( word, hash( word ) ); }
+        bool contains( std::string_view word, std::uint64_t hash ) const {
+            return position( word, hash ) != std::string_view::npos;
+        }
+
+        // slot of word, std::string_view::npos if missing, words stay in their slots until set is changed
+        std::size_t position( std::string_view word ) const { return position( word, hash( word ) ); }
+        std::size_t position( std::string_view word, std::uint64_t hash ) const {
+            if ( slots_.empty() )
+                return std::string_view::npos;
+            for ( std::size_t i = index( hash );; i = ( i + 1 ) & mask_ ) {
+                auto const& slot = slots_[ i ];
+                if ( slot.hash == hash && slot.view() == word )
+                    return i;
+                if ( slot.hash == 0 )
+                    return std::string_view::npos;
+            }
+        }
+        std::size_t positions() const { return slots_.size(); } // bound of positions
+
+        void emplace( std::string_view word ) { emplace( word, hash( word ) ); }
+        void emplace( std::string_view word, std::uint64_t hash ) {
+            if ( size_ >= growAt_ )
+                grow();
+            for ( std::size_t i = index( hash );; i = ( i + 1 ) & mask_ ) {
+                auto& slot = slots_[ i ];
+                if ( slot.hash == 0 ) {
+                    store( slot, word, hash );
+                    ++size_;
+                    return;
+                }
+                if ( slot.hash == hash && slot.view() == word )
+                    return;
+            }
+        }
+
+        // move all words of other to this set, other is left empty
+        void merge( FlatSet& other );
+
+        // call f( std::string_view ) for all words in slot order, views are valid until set is changed
+        template< typename F >
+        void forEach( F&& f ) const {
+            for ( auto const& slot : slots_ )
+                if ( slot.hash != 0 )
+                    f( slot.view() );
+        }
+
+        std::size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+        void reserve( std::size_t words );
+        void clear(); // keeps slots allocated
+
+      private:
+        struct Slot {
+            static constexpr std::uint8_t kLong = 0xff; // size marker of word stored outside of slot
+            static constexpr std::size_t kInline = 23;
+
+            std::uint64_t hash = 0;
+            std::uint8_t size = 0;
+            char data[ kInline ];
+
+            std::string_view view() const {
+                if ( size != kLong )
+                    return { data, size };
+                char const* ptr;
+                std::size_t len;
+                std::memcpy( &ptr, data, sizeof( ptr ) );
+                std::memcpy( &len, data + sizeof( ptr ), sizeof( len ) );
+                return { ptr, len };
+            }
+        };
+        static_assert( sizeof( Slot ) == 32 );
+
+        static constexpr std::size_t kMinSlots = 1024;
+        static constexpr std::size_t kChunkSize = util::kHugePage;
+
+        std::vector< Slot, util::ArenaAllocator< Slot > > slots_;
+        std::size_t mask_ = 0;
+        unsigned shift_ = 64;
+        std::size_t size_ = 0;
+        std::size_t growAt_ = 0; // max load factor 3/4
+
+        std::vector< std::unique_ptr< char[] > > chunks_; // storage of long words
+        char* chunkNext_ = nullptr;
+        std::size_t chunkFree_ = 0;
+
+        std::size_t index( std::uint64_t hash ) const {
+            return static_cast< std::size_t >( ( hash * 0x9E3779B97F4A7C15ull ) >> shift_ );
+        }
+        void store( Slot& slot, std::string_view word, std::uint64_t hash ) {
+            slot.hash = hash;
+            if ( word.size() <= Slot::kInline ) {
+                slot.size = static_cast< std::uint8_t >( word.size() );
+                std::memcpy( slot.data, word.data(), word.size() );
+            } else
+                storeLong( slot, word );
+        }
+        void storeLong( Slot& slot, std::string_view word );
+        void grow();
+        void rehash( std::size_t slots );
+    };
+
+    extern template class FlatSet< hash::Std >;
+    extern template class FlatSet< hash::Wy >;
+    extern template class FlatSet< hash::Crc32c >;
+    extern template class FlatSet< hash::Packed >;
+
+} // namespace uwc
+
+#endif
@@ -1,12 +1,18 @@
 #include "util.hpp"
 #include <cstdio>
+#include <algorithm>
+#include <cmath>
 #include <deque>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <optional>
 #include <random>
 #include <set>
 #include <string>
 #include <thread>
+#include <unordered_set>
+#include <vector>
 
 namespace gen {
 
@@ -37,16 +43,113 @@ namespace gen {
         std::uniform_int_distribution< int > repeatWord( 0, 99 );
         std::uniform_int_distribution< int > newlinePool( 0, 99 );
 
-        void randomWord( std::string& result ) {
+        void randomWord( std::string& result, int len ) {
             result.clear();
-            int len = wordsLenPool( mt );
             std::uniform_int_distribution< std::size_t > pick( 0, letters.size() - 1 );
             for ( int idx = 0; idx < len; ++idx )
                 result.push_back( letters[ pick( mt ) ] );
         }
+        void randomWord( std::string& result ) { randomWord( result, wordsLenPool( mt ) ); }
+
+        // Word lengths of vocabulary: uniform:<min>-<max>, normal:<mean>,<stddev> or english
+        // (frequencies of word lengths in English text)
+        class LengthDistribution {
+          public:
+            explicit LengthDistribution( std::string const& spec = "uniform:1-25" ) {
+                std::vector< double > weights;
+                std::size_t count = 0;
+                auto number = [ & ]( std::string const& text ) {
+                    auto value = std::stod( text, &count );
+                    if ( count < text.size() )
+                        throw std::invalid_argument( text );
+                    return value;
+                };
+                try {
+                    if ( spec.starts_with( "uniform:" ) ) {
+                        auto dash = spec.find( '-', 8 );
+                        int min = static_cast< int >( number( spec.substr( 8, dash - 8 ) ) );
+                        int max = dash == std::string::npos ? -1 : static_cast< int >( number( spec.substr( dash + 1 ) ) );
+                        if ( min < 1 || max < min || max > kMaxLength )
+                            throw std::invalid_argument( spec );
+                        weights.assign( max + 1, 0 );
+                        std::fill( weights.begin() + min, weights.end(), 1 );
+                    } else if ( spec.starts_with( "normal:" ) ) {
+                        auto comma = spec.find( ',', 7 );
+                        if ( comma == std::string::npos )
+                            throw std::invalid_argument( spec );
+                        double mean = number( spec.substr( 7, comma - 7 ) ), stddev = number( spec.substr( comma + 1 ) );
+                        if ( mean < 1 || mean > kMaxLength || stddev <= 0 )
+                            throw std::invalid_argument( spec );
+                        weights.assign( kMaxLength + 1, 0 );
+                        for ( int len = 1; len <= kMaxLength; ++len )
+                            weights[ len ] = std::exp( -0.5 * std::pow( ( len - mean ) / stddev, 2 ) );
+                    } else if ( spec == "english" )
+                        weights = { 0, 3.2, 16.9, 21.1, 16.2, 10.8, 8.3, 7.5, 5.6, 4.0, 2.8, 1.6, 0.9, 0.5, 0.3, 0.2, 0.1 };
+                    else
+                        throw std::invalid_argument( spec );
+                } catch ( std::logic_error const& ) {
+                    throw std::runtime_error( "Invalid value of -length '" + spec
+                                              + "', should be uniform:<min>-<max>, normal:<mean>,<stddev> or english "
+                                                "with lengths in range [1,"
+                                              + std::to_string( kMaxLength ) + "]" );
+                }
+                dist_ = std::discrete_distribution< int >( weights.begin(), weights.end() );
+            }
+            int operator()() { return dist_( mt ); }
+
+          private:
+            static constexpr int kMaxLength = 100;
+            std::discrete_distribution< int > dist_;
+        };
+
+        // Zipf distribution of ranks 1..n with exponent s > 0 by rejection-inversion
+        // (W. Hormann, G. Derflinger: Rejection-inversion to generate variates from monotone discrete distributions),
+        // constant memory, so vocabulary can be large.
+        class ZipfDistribution {
+          public:
+            ZipfDistribution( std::size_t n, double s ) : n_( static_cast< double >( n ) ), s_( s ) {
+                hIntegralX1_ = hIntegral( 1.5 ) - 1.0;
+                hIntegralN_ = hIntegral( n_ + 0.5 );
+                threshold_ = 2.0 - hIntegralInverse( hIntegral( 2.5 ) - h( 2.0 ) );
+            }
+            std::size_t operator()() {
+                std::uniform_real_distribution< double > uniform( 0.0, 1.0 );
+                while ( true ) {
+                    double u = hIntegralN_ + uniform( mt ) * ( hIntegralX1_ - hIntegralN_ );
+                    double x = hIntegralInverse( u );
+                    double k = std::clamp( std::floor( x + 0.5 ), 1.0, n_ );
+                    if ( k - x <= threshold_ || u >= hIntegral( k + 0.5 ) - h( k ) )
+                        return static_cast< std::size_t >( k );
+                }
+            }
+
+          private:
+            double n_, s_;
+            double hIntegralX1_, hIntegralN_, threshold_;
+
+            double h( double x ) const { return std::exp( -s_ * std::log( x ) ); }
+            double hIntegral( double x ) const {
+                double logX = std::log( x );
+                return helper2( ( 1.0 - s_ ) * logX ) * logX;
+            }
+            double hIntegralInverse( double x ) const {
+                double t = std::max( -1.0, x * ( 1.0 - s_ ) );
+                return std::exp( helper1( t ) * x );
+            }
+            // log(1 + x) / x and (exp(x) - 1) / x, stable around 0
+            static double helper1( double x ) {
+                return std::abs( x ) > 1e-8 ? std::log1p( x ) / x : 1.0 - x * ( 0.5 - x * ( 1.0 / 3.0 - 0.25 * x ) );
+            }
+            static double helper2( double x ) {
+                return std::abs( x ) > 1e-8 ? std::expm1( x ) / x : 1.0 + x * 0.5 * ( 1.0 + x / 3.0 * ( 1.0 + 0.25 * x ) );
+            }
+        };
 
         const std::string_view sw_m = "-multiline=";
         const std::string_view sw_r = "-repeat=";
+        const std::string_view sw_z = "-zipf=";
+        const std::string_view sw_d = "-distinct=";
+        const std::string_view sw_l = "-length=";
 
     } // namespace
 
@@ -55,11 +158,19 @@ namespace gen {
         std::size_t size_ = 0;
         int repeat_ = 0;
         int multiline_ = 0;
+        std::optional< double > zipf_;         // word frequency exponent, uniform frequency if not set
+        std::size_t distinct_ = 0;             // vocabulary size, 0 -> words picked by -repeat
+        std::string length_ = "uniform:1-25"; // length distribution of vocabulary
 
       public:
         App() {}
 
-        void usage() { std::cout << "Usage: gen [-multiline=<pecent>] [-repeat=<percent>] <output_path> <output_size> \n"; }
+        void usage() {
+            std::cout << "Usage: gen [-multiline=<pecent>] [-repeat=<percent>] <output_path> <output_size> \n"
+                         "       gen [-multiline=<pecent>] -distinct=<words> [-zipf=<s>] "
+                         "[-length=uniform:<min>-<max>|normal:<mean>,<stddev>|english] <output_path> <output_size> \n"
+                         "Exact number of distinct words is written to <output_path>.distinct\n";
+        }
 
         bool processCmdline( int argc, char** argv ) {
             std::string val, size, reps;
@@ -80,6 +191,19 @@ namespace gen {
                         if ( count < val.size() || repeat_ < 1 || repeat_ > 99 )
                             throw std::runtime_error(
                                 "Invalid value of -repeat '" + val + "', should be integer in range [1,99]" );
+                    } else if ( val.starts_with( sw_z ) ) {
+                        val.erase( 0, sw_z.size() );
+                        zipf_ = std::stod( val, &count );
+                        if ( count < val.size() || *zipf_ <= 0 || *zipf_ > 10 )
+                            throw std::runtime_error( "Invalid value of -zipf '" + val + "', should be number in range (0,10]" );
+                    } else if ( val.starts_with( sw_d ) ) {
+                        val.erase( 0, sw_d.size() );
+                        distinct_ = util::parseNumberWithOptionalSuffix( val );
+                        if ( distinct_ == 0 )
+                            throw std::runtime_error( "Invalid value of -distinct '" + val + "'" );
+                    } else if ( val.starts_with( sw_l ) ) {
+                        length_ = val.substr( sw_l.size() );
+                        LengthDistribution{ length_ }; // validate
                     } else {
                         if ( out_.empty() )
                             out_ = val;
@@ -103,44 +227,32 @@ namespace gen {
                 std::cerr << "Error: specify output file size\n";
                 return false;
             }
+            if ( distinct_ == 0 && ( zipf_ || length_ != "uniform:1-25" ) ) {
+                std::cerr << "Error: -zipf and -length need vocabulary size -distinct\n";
+                return false;
+            }
+            if ( distinct_ > 0 && repeat_ > 0 ) {
+                std::cerr << "Error: -repeat cannot be combined with -distinct\n";
+                return false;
+            }
 
             return true;
         }
 
-        int generate() {
-            std::ofstream of( out_, std::ios::trunc );
-            if ( !of ) {
-                std::cerr << "Error: Cannot open output file: " << out_ << "." << std::endl;
-                return 1;
-            }
-
-            std::cout << "Generating file (requested size=" << size_ << ", repeat=" << repeat_ << "%): " //
-                      << out_ << "..." << std::endl;
+        // call next( buffer ) to append words till output has requested size, return number of words
+        template< typename NEXT >
+        std::size_t write( std::ofstream& of, NEXT&& next ) {
             const std::size_t wbs = 16 * util::kMB; // write buffer size
 
-            std::string buffer, word;
-            std::deque< std::string > usedWords;
-
+            std::string buffer;
             buffer.reserve( wbs );
             std::size_t len = 0;
             std::size_t words = 0;
-            std::set< std::string > unique;
             while ( len < size_ ) {
                 // extra space?
                 if ( boolPool( mt ) )
                     buffer += " ";
-                if ( !usedWords.empty() && repeatWord( mt ) <= repeat_ ) {
-                    std::uniform_int_distribution< std::size_t > pickWord( 0, usedWords.size() - 1 );
-                    auto idx = pickWord( mt );
-                    buffer += usedWords[ idx ];
-                } else {
-                    randomWord( word );
-                    while ( unique.contains( word ) )
-                        randomWord( word );
-                    unique.insert( word );
-                    usedWords.push_back( word );
-                    buffer += word;
-                }
+                next( buffer );
                 ++words;
                 if ( multiline_ == 0 )
                     buffer += " ";
@@ -159,8 +271,99 @@ namespace gen {
             }
             if ( !buffer.empty() )
                 of.write( buffer.c_str(), buffer.size() );
+            return words;
+        }
+
+        // new words are random, repeated ones are picked uniformly from words used so far
+        std::size_t generateRepeat( std::ofstream& of, std::size_t& words ) {
+            std::string word;
+            std::deque< std::string > usedWords;
+            std::set< std::string > unique;
+            words = write( of, [ & ]( std::string& buffer ) {
+                if ( !usedWords.empty() && repeatWord( mt ) <= repeat_ ) {
+                    std::uniform_int_distribution< std::size_t > pickWord( 0, usedWords.size() - 1 );
+                    auto idx = pickWord( mt );
+                    buffer += usedWords[ idx ];
+                } else {
+                    randomWord( word );
+                    while ( unique.contains( word ) )
+                        randomWord( word );
+                    unique.insert( word );
+                    usedWords.push_back( word );
+                    buffer += word;
+                }
+            } );
+            return unique.size();
+        }
+
+        // words are picked from vocabulary of distinct_ words by rank, uniformly or by Zipf distribution,
+        // vocabulary is ordered by length, so with Zipf short words are the frequent ones
+        std::size_t generateVocabulary( std::ofstream& of, std::size_t& words ) {
+            std::vector< std::string > vocabulary;
+            {
+                LengthDistribution lengths( length_ );
+                std::unordered_set< std::string > unique;
+                unique.reserve( distinct_ );
+                std::string word;
+                std::size_t failures = 0;
+                while ( unique.size() < distinct_ ) {
+                    randomWord( word, lengths() );
+                    if ( unique.insert( word ).second )
+                        failures = 0;
+                    else if ( ++failures > 1000 )
+                        throw std::runtime_error( "Cannot generate " + std::to_string( distinct_ )
+                                                  + " distinct words with lengths " + length_ + ", got only "
+                                                  + std::to_string( unique.size() ) );
+                }
+                vocabulary.reserve( distinct_ );
+                for ( auto it = unique.begin(); it != unique.end(); )
+                    vocabulary.push_back( std::move( unique.extract( it++ ).value() ) );
+            }
+            std::sort( vocabulary.begin(), vocabulary.end(),
+                       []( std::string const& a, std::string const& b ) { return a.size() < b.size(); } );
+
+            std::vector< bool > used( distinct_ );
+            std::size_t unique = 0;
+            std::optional< ZipfDistribution > zipf;
+            if ( zipf_ )
+                zipf.emplace( distinct_, *zipf_ );
+            std::uniform_int_distribution< std::size_t > uniform( 1, distinct_ );
+            words = write( of, [ & ]( std::string& buffer ) {
+                std::size_t idx = ( zipf ? ( *zipf )() : uniform( mt ) ) - 1;
+                if ( !used[ idx ] ) {
+                    used[ idx ] = true;
+                    ++unique;
+                }
+                buffer += vocabulary[ idx ];
+            } );
+            return unique;
+        }
+
+        int generate() {
+            std::ofstream of( out_, std::ios::trunc );
+            if ( !of ) {
+                std::cerr << "Error: Cannot open output file: " << out_ << "." << std::endl;
+                return 1;
+            }
+
+            if ( distinct_ == 0 )
+                std::cout << "Generating file (requested size=" << size_ << ", repeat=" << repeat_ << "%): " //
+                          << out_ << "..." << std::endl;
+            else
+                std::cout << "Generating file (requested size=" << size_ << ", vocabulary=" << distinct_ << ", lengths "
+                          << length_ << ", " << ( zipf_ ? "zipf s=" + std::to_string( *zipf_ ) : "uniform" )
+                          << "): " << out_ << "..." << std::endl;
+
+            std::size_t words = 0;
+            std::size_t unique = distinct_ == 0 ? generateRepeat( of, words ) : generateVocabulary( of, words );
+            of.close();
+
+            // ground truth for tests and benchmarks
+            auto sidecar = out_;
+            sidecar += ".distinct";
+            std::ofstream( sidecar, std::ios::trunc ) << unique << "\n";
 
-            std::cout << "File " << out_ << " contains " << words << " words (" << unique.size() << " unique)" << std::endl;
+            std::cout << "File " << out_ << " contains " << words << " words (" << unique << " unique)" << std::endl;
             return 0;
         }
 
@@ -0,0 +1,121 @@
+#include "hash.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+
+#if defined( __x86_64__ )
+#    include <nmmintrin.h>
+#endif
+
+namespace uwc::hash {
+
+    namespace {
+        const std::uint32_t kCrc32cPoly = 0x82f63b78; // reflected Castagnoli polynomial
+
+        constexpr std::array< std::uint32_t, 256 > crcTable = [] {
+            std::array< std::uint32_t, 256 > table{};
+            for ( std::uint32_t i = 0; i < 256; ++i ) {
+                std::uint32_t crc = i;
+                for ( int bit = 0; bit < 8; ++bit )
+                    crc = crc & 1 ? ( crc >> 1 ) ^ kCrc32cPoly : crc >> 1;
+                table[ i ] = crc;
+            }
+            return table;
+        }();
+
+#if defined( __x86_64__ )
+        __attribute__( ( target( "sse4.2" ) ) ) std::uint32_t crc32cSse42( std::string_view data, std::uint32_t crc ) {
+            char const* p = data.data();
+            std::size_t len = data.size();
+            std::uint64_t c = ~crc;
+            for ( ; len >= 8; len -= 8, p += 8 ) {
+                std::uint64_t v;
+                std::memcpy( &v, p, 8 );
+                c = _mm_crc32_u64( c, v );
+            }
+            auto c32 = static_cast< std::uint32_t >( c );
+            if ( len >= 4 ) {
+                std::uint32_t v;
+                std::memcpy( &v, p, 4 );
+                c32 = _mm_crc32_u32( c32, v );
+                p += 4;
+                len -= 4;
+            }
+            for ( ; len > 0; --len, ++p )
+                c32 = _mm_crc32_u8( c32, static_cast< unsigned char >( *p ) );
+            return ~c32;
+        }
+        __attribute__( ( target( "sse4.2" ) ) ) std::uint64_t crc32c64Sse42( std::string_view data ) {
+            char const* p = data.data();
+            std::size_t len = data.size();
+            std::uint64_t lo = static_cast< std::uint32_t >( len ), hi = ~lo & 0xffffffff;
+            for ( ; len >= 8; len -= 8, p += 8 ) {
+                std::uint64_t v;
+                std::memcpy( &v, p, 8 );
+                lo = _mm_crc32_u64( lo, v );
+                hi = _mm_crc32_u64( hi, std::rotl( v, 32 ) );
+            }
+            if ( len > 0 ) {
+                std::uint64_t v = 0;
+                std::memcpy( &v, p, len );
+                lo = _mm_crc32_u64( lo, v );
+                hi = _mm_crc32_u64( hi, std::rotl( v, 32 ) );
+            }
+            return ( hi << 32 ) | lo;
+        }
+        const bool hasSse42 = [] {
+            __builtin_cpu_init(); // may run before other static constructors
+            return __builtin_cpu_supports( "sse4.2" ) != 0;
+        }();
+#else
+        const bool hasSse42 = false;
+#endif
+    } // namespace
+
+    std::uint32_t crc32cSoftware( std::string_view data, std::uint32_t crc ) {
+        crc = ~crc;
+        for ( char ch : data )
+            crc = crcTable[ ( crc ^ static_cast< unsigned char >( ch ) ) & 0xff ] ^ ( crc >> 8 );
+        return ~crc;
+    }
+
+    bool crc32cHardware() { return hasSse42; }
+
+    std::uint64_t crc32c64Software( std::string_view data ) {
+        // CRC of 8 bytes of v in memory order, without inversions like the crc32 instruction
+        auto update = []( std::uint32_t crc, std::uint64_t v ) {
+            unsigned char bytes[ 8 ];
+            std::memcpy( bytes, &v, 8 );
+            for ( unsigned char b : bytes )
+                crc = crcTable[ ( crc ^ b ) & 0xff ] ^ ( crc >> 8 );
+            return crc;
+        };
+        char const* p = data.data();
+        std::size_t len = data.size();
+        std::uint32_t lo = static_cast< std::uint32_t >( len ), hi = ~lo;
+        for ( ; len > 0; len -= std::min< std::size_t >( len, 8 ), p += 8 ) {
+            std::uint64_t v = 0;
+            std::memcpy( &v, p, std::min< std::size_t >( len, 8 ) );
+            lo = update( lo, v );
+            hi = update( hi, std::rotl( v, 32 ) );
+        }
+        return ( std::uint64_t( hi ) << 32 ) | lo;
+    }
+
+    std::uint64_t crc32c64( std::string_view data ) {
+#if defined( __x86_64__ )
+        if ( hasSse42 )
+            return crc32c64Sse42( data );
+#endif
+        return crc32c64Software( data );
+    }
+
+    std::uint32_t crc32c( std::string_view data, std::uint32_t crc ) {
+#if defined( __x86_64__ )
+        if ( hasSse42 )
+            return crc32cSse42( data, crc );
+#endif
+        return crc32cSoftware( data, crc );
+    }
+
+} // namespace uwc::hash
@@ -0,0 +1,163 @@
+#ifndef HASH_HPP
+#define HASH_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <version>
+
+// Hash policies of word sets: static std::uint64_t hash( std::string_view ) and name for reports.
+namespace uwc::hash {
+
+    // std::hash, differs between libstdc++ and libc++
+    struct Std {
+        static constexpr char const* name = "std";
+        static std::uint64_t hash( std::string_view word ) { return std::hash< std::string_view >{}( word ); }
+    };
+
+    namespace detail {
+        __extension__ typedef unsigned __int128 uint128;
+
+        const std::uint64_t kWySecret0 = 0xa0761d6478bd642full;
+        const std::uint64_t kWySecret1 = 0xe7037ed1a0b428dbull;
+
+        inline void mum( std::uint64_t& a, std::uint64_t& b ) {
+            uint128 r = static_cast< uint128 >( a ) * b;
+            a = static_cast< std::uint64_t >( r );
+            b = static_cast< std::uint64_t >( r >> 64 );
+        }
+        inline std::uint64_t mix( std::uint64_t a, std::uint64_t b ) {
+            mum( a, b );
+            return a ^ b;
+        }
+        inline std::uint64_t read8( char const* p ) {
+            std::uint64_t v;
+            std::memcpy( &v, p, 8 );
+            return v;
+        }
+        inline std::uint64_t read4( char const* p ) {
+            std::uint32_t v;
+            std::memcpy( &v, p, 4 );
+            return v;
+        }
+        inline std::uint64_t read3( char const* p, std::size_t k ) {
+            return ( static_cast< std::uint64_t >( static_cast< unsigned char >( p[ 0 ] ) ) << 16 )
+                   | ( static_cast< std::uint64_t >( static_cast< unsigned char >( p[ k >> 1 ] ) ) << 8 )
+                   | static_cast< unsigned char >( p[ k - 1 ] );
+        }
+    } // namespace detail
+
+    // wyhash (final version 4, seed 0, single lane for long input): words up to 16 bytes take two overlapping
+    // loads and two multiplications
+    struct Wy {
+        static constexpr char const* name = "wy";
+        static std::uint64_t hash( std::string_view word ) {
+            using namespace detail;
+            char const* p = word.data();
+            std::size_t len = word.size();
+            std::uint64_t seed = mix( kWySecret0, kWySecret1 ); // seed 0
+            std::uint64_t a, b;
+            if ( len <= 16 ) {
+                if ( len >= 4 ) {
+                    std::size_t shift = ( len >> 3 ) << 2;
+                    a = ( read4( p ) << 32 ) | read4( p + shift );
+                    b = ( read4( p + len - 4 ) << 32 ) | read4( p + len - 4 - shift );
+                } else if ( len > 0 ) {
+                    a = read3( p, len );
+                    b = 0;
+                } else
+                    a = b = 0;
+            } else {
+                std::size_t i = len;
+                for ( ; i > 16; i -= 16, p += 16 )
+                    seed = mix( read8( p ) ^ kWySecret1, read8( p + 8 ) ^ seed );
+                a = read8( p + i - 16 );
+                b = read8( p + i - 8 );
+            }
+            a ^= kWySecret1;
+            b ^= seed;
+            mum( a, b );
+            return mix( a ^ kWySecret0 ^ len, b ^ kWySecret1 );
+        }
+    };
+
+    // CRC32C of word, SSE4.2 crc32 instruction when the CPU has it (checked at runtime), table otherwise
+    std::uint32_t crc32c( std::string_view data, std::uint32_t crc = 0 );
+    std::uint32_t crc32cSoftware( std::string_view data, std::uint32_t crc = 0 );
+    bool crc32cHardware();
+
+    // 64 bit hash of two CRC32C lanes seeded by length, low one over 8 byte blocks of data (zero padded),
+    // high one over the blocks rotated by 32 bits, so the lanes are independent functions of the data
+    std::uint64_t crc32c64( std::string_view data );
+    std::uint64_t crc32c64Software( std::string_view data );
+
+    struct Crc32c {
+        static constexpr char const* name = "crc32c";
+        static std::uint64_t hash( std::string_view word ) { return crc32c64( word ); }
+    };
+
+    // Words of up to 12 letters 'a'..'z' are their own hash (5 bits per letter, unique for each word),
+    // sets spread them by fibonacci hashing of slot index, other words are hashed by Wy.
+    struct Packed {
+        static constexpr char const* name = "packed";
+        static constexpr std::size_t kMaxLength = 12;
+        static std::uint64_t hash( std::string_view word ) {
+            if ( word.size() <= kMaxLength ) {
+                std::uint64_t key = 0;
+                for ( char c : word ) {
+                    unsigned code = static_cast< unsigned char >( c ) - ( 'a' - 1 );
+                    if ( code - 1 > 25 )
+                        return Wy::hash( word );
+                    key = ( key << 5 ) | code;
+                }
+                return key;
+            }
+            return Wy::hash( word );
+        }
+    };
+
+} // namespace uwc::hash
+
+namespace uwc {
+
+    // key to look up word in unordered set: the word itself with heterogenous unordered lookup (libstdc++ 11+)
+    // and transparent hash, otherwise a copy of key type (libstdc++ 10 of Ubuntu 20.04)
+    template< typename Set >
+    auto lookupKey( std::string_view word ) {
+#ifdef __cpp_lib_generic_unordered_lookup
+        if constexpr ( requires { typename Set::hasher::is_transparent; } )
+            return word;
+        else
+#endif
+            return typename Set::key_type( word );
+    }
+
+    // Position of word in unordered set which is not changed meanwhile: bucket + place in bucket * bucket count,
+    // std::string_view::npos if set does not contain word. Positions are below bucketPositions( set ), bucket count
+    // times size of the biggest bucket (a few buckets for load factor <= 1).
+    template< typename Set >
+    std::size_t bucketPosition( Set const& set, std::string_view word ) {
+        auto it = set.find( lookupKey< Set >( word ) );
+        if ( it == set.end() )
+            return std::string_view::npos;
+        auto bucket = set.bucket( *it );
+        std::size_t place = 0;
+        for ( auto i = set.begin( bucket ); &*i != &*it; ++i )
+            ++place;
+        return place * set.bucket_count() + bucket;
+    }
+    template< typename Set >
+    std::size_t bucketPositions( Set const& set ) {
+        std::size_t depth = 0;
+        for ( std::size_t bucket = 0; bucket < set.bucket_count(); ++bucket )
+            depth = std::max( depth, set.bucket_size( bucket ) );
+        return depth * set.bucket_count();
+    }
+
+} // namespace uwc
+
+#endif
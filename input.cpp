@@ -0,0 +1,571 @@
+#include "input.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#ifdef UWC_HAVE_ZLIB
+#    include <zlib.h>
+#endif
+#ifdef UWC_HAVE_ZSTD
+#    include <zstd.h>
+#endif
+
+namespace util {
+
+    namespace {
+        const std::size_t kBlockSize = 4 * 1024 * 1024; // decompressed data handed over between threads
+        // frames decoded in parallel at most, decoders hold 2 slots each, bigger frames are decoded as stream
+        const std::size_t kMaxParallelFrame = 8 * kBlockSize;
+
+        std::uint16_t le16( unsigned char const* p ) { return static_cast< std::uint16_t >( p[ 0 ] | ( p[ 1 ] << 8 ) ); }
+        std::uint32_t le32( unsigned char const* p ) {
+            return std::uint32_t( p[ 0 ] ) | ( std::uint32_t( p[ 1 ] ) << 8 ) | ( std::uint32_t( p[ 2 ] ) << 16 )
+                | ( std::uint32_t( p[ 3 ] ) << 24 );
+        }
+
+        std::string compressionName( Compression c ) {
+            switch ( c ) {
+                case Compression::Gzip: return "gzip";
+                case Compression::Zstd: return "zstd";
+                default: return "plain";
+            }
+        }
+
+        class PlainInput : public Input {
+            std::ifstream stream_;
+            bool eof_ = false;
+
+          public:
+            explicit PlainInput( std::filesystem::path const& path ) : stream_( path, std::ios::binary ) {
+                if ( !stream_ )
+                    throw std::runtime_error( "Cannot open input file: " + path.string() );
+            }
+            std::size_t read( char* dst, std::size_t size ) override {
+                stream_.read( dst, size );
+                if ( stream_.eof() )
+                    eof_ = true;
+                else if ( !stream_ )
+                    throw std::runtime_error( "Error reading input file" );
+                return stream_.gcount();
+            }
+            bool eof() const override { return eof_; }
+            std::string describe() const override { return "plain"; }
+        };
+
+        // whole file mapped read only
+        class MappedFile {
+            unsigned char const* data_ = nullptr;
+            std::size_t size_ = 0;
+
+            MappedFile( MappedFile const& ) = delete;
+            MappedFile& operator=( MappedFile const& ) = delete;
+
+          public:
+            explicit MappedFile( std::filesystem::path const& path ) {
+                int fd = ::open( path.c_str(), O_RDONLY );
+                if ( fd < 0 )
+                    throw std::runtime_error( "Cannot open input file: " + path.string() );
+                struct stat st;
+                if ( ::fstat( fd, &st ) == 0 && st.st_size > 0 ) {
+                    size_ = static_cast< std::size_t >( st.st_size );
+                    void* p = ::mmap( nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0 );
+                    if ( p == MAP_FAILED ) {
+                        ::close( fd );
+                        throw std::runtime_error( "Cannot map input file: " + path.string() );
+                    }
+                    data_ = static_cast< unsigned char const* >( p );
+                }
+                ::close( fd );
+            }
+            ~MappedFile() {
+                if ( data_ )
+                    ::munmap( const_cast< unsigned char* >( data_ ), size_ );
+            }
+            unsigned char const* data() const { return data_; }
+            std::size_t size() const { return size_; }
+        };
+
+        // independently decodable part of compressed file with known decompressed size
+        struct Frame {
+            std::size_t offset;
+            std::size_t size;
+            std::size_t decompressed;
+        };
+
+        // frames are decoded in parallel if there are more of them and none is bigger than kMaxParallelFrame
+        // (sizes come from untrusted headers)
+        bool decodeInParallel( std::vector< Frame > const& frames ) {
+            return frames.size() > 1 && std::all_of( frames.begin(), frames.end(), []( Frame const& frame ) {
+                       return frame.decompressed <= kMaxParallelFrame;
+                   } );
+        }
+
+        // gzip members with BGZF block size in extra field (bgzip, htslib), empty if any member has no block size
+        [[maybe_unused]] std::vector< Frame > indexGzipBlocks( MappedFile const& file ) {
+            std::vector< Frame > frames;
+            auto const* p = file.data();
+            std::size_t n = file.size(), off = 0;
+            while ( off < n ) {
+                if ( n - off < 18 || p[ off ] != 0x1f || p[ off + 1 ] != 0x8b || p[ off + 2 ] != 8 || !( p[ off + 3 ] & 4 ) )
+                    return {};
+                std::size_t xlen = le16( p + off + 10 );
+                std::size_t x = off + 12, xend = x + xlen, block = 0;
+                if ( xend > n )
+                    return {};
+                while ( x + 4 <= xend ) {
+                    std::size_t slen = le16( p + x + 2 );
+                    if ( p[ x ] == 'B' && p[ x + 1 ] == 'C' && slen == 2 && x + 6 <= xend ) {
+                        block = le16( p + x + 4 ) + 1u;
+                        break;
+                    }
+                    x += 4 + slen;
+                }
+                if ( block < 18 + xlen || off + block > n )
+                    return {};
+                frames.push_back( { off, block, le32( p + off + block - 4 ) } );
+                off += block;
+            }
+            return frames;
+        }
+
+#ifdef UWC_HAVE_ZSTD
+        // zstd frames, empty if any frame doesn't store its decompressed size
+        std::vector< Frame > indexZstdFrames( MappedFile const& file ) {
+            std::vector< Frame > frames;
+            auto const* p = file.data();
+            std::size_t n = file.size(), off = 0;
+            while ( off < n ) {
+                std::size_t size = ZSTD_findFrameCompressedSize( p + off, n - off );
+                if ( ZSTD_isError( size ) )
+                    throw std::runtime_error( std::string( "Corrupted zstd input: " ) + ZSTD_getErrorName( size ) );
+                auto content = ZSTD_getFrameContentSize( p + off, n - off );
+                if ( content == ZSTD_CONTENTSIZE_UNKNOWN || content == ZSTD_CONTENTSIZE_ERROR )
+                    return {};
+                frames.push_back( { off, size, static_cast< std::size_t >( content ) } );
+                off += size;
+            }
+            return frames;
+        }
+#endif
+
+        // decodes groups of frames in decoder threads, hands them over in order
+        class ParallelInput : public Input {
+            struct Task {
+                std::size_t first, last; // frames [first,last)
+                std::size_t size;        // decompressed
+            };
+            struct Slot {
+                std::vector< char > data;
+                bool ready = false;
+            };
+
+            std::unique_ptr< MappedFile > file_;
+            Compression compression_;
+            std::vector< Frame > frames_;
+            std::vector< Task > tasks_;
+            std::vector< Slot > slots_; // task t is decoded into slot t % slots_.size()
+
+            std::mutex m_;
+            std::condition_variable cv_;
+            std::size_t next_ = 0;     // next task to decode
+            std::size_t consumed_ = 0; // tasks consumed by reader
+            std::size_t pos_ = 0;      // read position in current task
+            bool stop_ = false;
+            std::exception_ptr error_;
+            std::vector< std::thread > decoders_;
+
+            void decode( Task const& task, std::vector< char >& out ) {
+                out.resize( task.size );
+                char* dst = out.data();
+#ifdef UWC_HAVE_ZLIB
+                z_stream zs{};
+                if ( compression_ == Compression::Gzip && inflateInit2( &zs, 16 + MAX_WBITS ) != Z_OK )
+                    throw std::runtime_error( "Cannot initialize zlib" );
+#endif
+#ifdef UWC_HAVE_ZSTD
+                ZSTD_DCtx* dctx = compression_ == Compression::Zstd ? ZSTD_createDCtx() : nullptr;
+#endif
+                try {
+                    for ( std::size_t f = task.first; f < task.last; ++f ) {
+                        auto const& frame = frames_[ f ];
+                        [[maybe_unused]] auto const* src = file_->data() + frame.offset;
+                        if ( compression_ == Compression::Gzip ) {
+#ifdef UWC_HAVE_ZLIB
+                            inflateReset( &zs );
+                            zs.next_in = const_cast< unsigned char* >( src );
+                            zs.avail_in = static_cast< uInt >( frame.size );
+                            zs.next_out = reinterpret_cast< unsigned char* >( dst );
+                            zs.avail_out = static_cast< uInt >( frame.decompressed );
+                            if ( inflate( &zs, Z_FINISH ) != Z_STREAM_END || zs.avail_out != 0 )
+                                throw std::runtime_error( "Corrupted gzip block at offset " + std::to_string( frame.offset ) );
+#endif
+                        } else {
+#ifdef UWC_HAVE_ZSTD
+                            auto r = ZSTD_decompressDCtx( dctx, dst, frame.decompressed, src, frame.size );
+                            if ( ZSTD_isError( r ) || r != frame.decompressed )
+                                throw std::runtime_error( "Corrupted zstd frame at offset " + std::to_string( frame.offset ) );
+#endif
+                        }
+                        dst += frame.decompressed;
+                    }
+                } catch ( ... ) {
+#ifdef UWC_HAVE_ZLIB
+                    if ( compression_ == Compression::Gzip )
+                        inflateEnd( &zs );
+#endif
+#ifdef UWC_HAVE_ZSTD
+                    ZSTD_freeDCtx( dctx );
+#endif
+                    throw;
+                }
+#ifdef UWC_HAVE_ZLIB
+                if ( compression_ == Compression::Gzip )
+                    inflateEnd( &zs );
+#endif
+#ifdef UWC_HAVE_ZSTD
+                ZSTD_freeDCtx( dctx );
+#endif
+            }
+
+            void decoder() {
+                while ( true ) {
+                    std::size_t t;
+                    {
+                        std::unique_lock lock( m_ );
+                        while ( !stop_ && next_ < tasks_.size() && next_ >= consumed_ + slots_.size() )
+                            cv_.wait( lock );
+                        if ( stop_ || next_ >= tasks_.size() )
+                            return;
+                        t = next_++;
+                    }
+                    auto& slot = slots_[ t % slots_.size() ];
+                    try {
+                        decode( tasks_[ t ], slot.data );
+                    } catch ( ... ) {
+                        std::unique_lock lock( m_ );
+                        error_ = std::current_exception();
+                        stop_ = true;
+                        cv_.notify_all();
+                        return;
+                    }
+                    std::unique_lock lock( m_ );
+                    slot.ready = true;
+                    cv_.notify_all();
+                }
+            }
+
+          public:
+            ParallelInput(
+                std::unique_ptr< MappedFile > file, Compression compression, std::vector< Frame > frames, unsigned threads )
+                : file_( std::move( file ) ), compression_( compression ), frames_( std::move( frames ) ) {
+                // group small frames (BGZF blocks are up to 64KB) into tasks of about kBlockSize
+                Task task{ 0, 0, 0 };
+                for ( std::size_t f = 0; f < frames_.size(); ++f ) {
+                    if ( task.size > 0 && task.size + frames_[ f ].decompressed > kBlockSize ) {
+                        tasks_.push_back( task );
+                        task = { f, f, 0 };
+                    }
+                    task.last = f + 1;
+                    task.size += frames_[ f ].decompressed;
+                }
+                if ( task.last > task.first )
+                    tasks_.push_back( task );
+                threads = std::max( 1u, std::min< unsigned >( threads, tasks_.size() ) );
+                slots_.resize( 2 * threads );
+                for ( unsigned i = 0; i < threads; ++i )
+                    decoders_.emplace_back( &ParallelInput::decoder, this );
+            }
+            ~ParallelInput() {
+                {
+                    std::unique_lock lock( m_ );
+                    stop_ = true;
+                    cv_.notify_all();
+                }
+                for ( auto& t : decoders_ )
+                    t.join();
+            }
+
+            std::size_t read( char* dst, std::size_t size ) override {
+                std::size_t done = 0;
+                std::unique_lock lock( m_ );
+                while ( done < size && consumed_ < tasks_.size() ) {
+                    auto& slot = slots_[ consumed_ % slots_.size() ];
+                    while ( !slot.ready && !error_ )
+                        cv_.wait( lock );
+                    if ( error_ )
+                        std::rethrow_exception( error_ );
+                    lock.unlock();
+                    std::size_t n = std::min( size - done, slot.data.size() - pos_ );
+                    std::memcpy( dst + done, slot.data.data() + pos_, n );
+                    done += n;
+                    pos_ += n;
+                    lock.lock();
+                    if ( pos_ == slot.data.size() ) {
+                        slot.ready = false;
+                        pos_ = 0;
+                        ++consumed_;
+                        cv_.notify_all();
+                    }
+                }
+                return done;
+            }
+            bool eof() const override { return consumed_ == tasks_.size(); }
+            std::string describe() const override {
+                return compressionName( compression_ ) + ", " + std::to_string( frames_.size() ) + " frames decoded by "
+                    + std::to_string( decoders_.size() ) + " threads";
+            }
+        };
+
+        // single stream decoder, used by decompress thread
+        class StreamDecoder {
+          public:
+            virtual ~StreamDecoder() = default;
+            virtual std::size_t decode( char* dst, std::size_t size ) = 0; // 0 at the end of data
+        };
+
+#ifdef UWC_HAVE_ZLIB
+        // handles single and multi member gzip files
+        class GzipDecoder : public StreamDecoder {
+            gzFile file_;
+
+          public:
+            explicit GzipDecoder( std::filesystem::path const& path ) : file_( gzopen( path.c_str(), "rb" ) ) {
+                if ( !file_ )
+                    throw std::runtime_error( "Cannot open input file: " + path.string() );
+                gzbuffer( file_, 1024 * 1024 );
+            }
+            ~GzipDecoder() { gzclose( file_ ); }
+            std::size_t decode( char* dst, std::size_t size ) override {
+                int n = gzread( file_, dst, static_cast< unsigned >( size ) );
+                int err = Z_OK;
+                char const* msg = gzerror( file_, &err );
+                if ( n < 0 || ( err != Z_OK && err != Z_STREAM_END ) ) // truncated input reported as Z_BUF_ERROR
+                    throw std::runtime_error( std::string( "gzip error: " ) + msg );
+                return static_cast< std::size_t >( n );
+            }
+        };
+#endif
+
+#ifdef UWC_HAVE_ZSTD
+        class ZstdDecoder : public StreamDecoder {
+            std::ifstream file_;
+            ZSTD_DStream* stream_;
+            std::vector< char > in_;
+            ZSTD_inBuffer input_{ nullptr, 0, 0 };
+            bool end_ = false;
+            std::size_t pending_ = 0; // last result of ZSTD_decompressStream, 0 when frame is complete
+
+          public:
+            explicit ZstdDecoder( std::filesystem::path const& path )
+                : file_( path, std::ios::binary ), stream_( ZSTD_createDStream() ), in_( ZSTD_DStreamInSize() ) {
+                if ( !file_ )
+                    throw std::runtime_error( "Cannot open input file: " + path.string() );
+                ZSTD_initDStream( stream_ );
+            }
+            ~ZstdDecoder() { ZSTD_freeDStream( stream_ ); }
+            std::size_t decode( char* dst, std::size_t size ) override {
+                ZSTD_outBuffer output{ dst, size, 0 };
+                while ( output.pos < output.size ) {
+                    if ( input_.pos == input_.size && !end_ ) {
+                        file_.read( in_.data(), in_.size() );
+                        input_ = { in_.data(), static_cast< std::size_t >( file_.gcount() ), 0 };
+                        end_ = input_.size == 0;
+                    }
+                    if ( end_ && pending_ == 0 )
+                        break;
+                    auto before = output.pos; // at the end of file decoder only flushes what it holds
+                    pending_ = ZSTD_decompressStream( stream_, &output, &input_ );
+                    if ( ZSTD_isError( pending_ ) )
+                        throw std::runtime_error( std::string( "zstd error: " ) + ZSTD_getErrorName( pending_ ) );
+                    if ( end_ && pending_ != 0 && output.pos == before )
+                        throw std::runtime_error( "Truncated zstd stream" );
+                }
+                return output.pos;
+            }
+        };
+#endif
+
+        // decompress thread filling blocks ahead of the reader
+        class PipelinedInput : public Input {
+            struct Slot {
+                std::vector< char > data;
+                std::size_t size = 0;
+                bool ready = false;
+                bool last = false;
+            };
+
+            std::unique_ptr< StreamDecoder > decoder_;
+            Compression compression_;
+            std::vector< Slot > slots_;
+            std::mutex m_;
+            std::condition_variable cv_;
+            std::size_t produced_ = 0, consumed_ = 0, pos_ = 0;
+            bool stop_ = false, eof_ = false;
+            std::exception_ptr error_;
+            std::thread thread_;
+
+            void produce() {
+                while ( true ) {
+                    {
+                        std::unique_lock lock( m_ );
+                        while ( !stop_ && produced_ >= consumed_ + slots_.size() )
+                            cv_.wait( lock );
+                        if ( stop_ )
+                            return;
+                    }
+                    auto& slot = slots_[ produced_ % slots_.size() ];
+                    try {
+                        slot.size = 0;
+                        while ( slot.size < slot.data.size() ) {
+                            auto n = decoder_->decode( slot.data.data() + slot.size, slot.data.size() - slot.size );
+                            if ( n == 0 ) {
+                                slot.last = true;
+                                break;
+                            }
+                            slot.size += n;
+                        }
+                    } catch ( ... ) {
+                        std::unique_lock lock( m_ );
+                        error_ = std::current_exception();
+                        cv_.notify_all();
+                        return;
+                    }
+                    std::unique_lock lock( m_ );
+                    slot.ready = true;
+                    ++produced_;
+                    cv_.notify_all();
+                    if ( slot.last )
+                        return;
+                }
+            }
+
+          public:
+            PipelinedInput( std::unique_ptr< StreamDecoder > decoder, Compression compression )
+                : decoder_( std::move( decoder ) ), compression_( compression ), slots_( 3 ) {
+                for ( auto& s : slots_ )
+                    s.data.resize( kBlockSize );
+                thread_ = std::thread( &PipelinedInput::produce, this );
+            }
+            ~PipelinedInput() {
+                {
+                    std::unique_lock lock( m_ );
+                    stop_ = true;
+                    cv_.notify_all();
+                }
+                thread_.join();
+            }
+
+            std::size_t read( char* dst, std::size_t size ) override {
+                std::size_t done = 0;
+                std::unique_lock lock( m_ );
+                while ( done < size && !eof_ ) {
+                    auto& slot = slots_[ consumed_ % slots_.size() ];
+                    while ( !slot.ready && !error_ )
+                        cv_.wait( lock );
+                    if ( error_ )
+                        std::rethrow_exception( error_ );
+                    lock.unlock();
+                    std::size_t n = std::min( size - done, slot.size - pos_ );
+                    std::memcpy( dst + done, slot.data.data() + pos_, n );
+                    done += n;
+                    pos_ += n;
+                    lock.lock();
+                    if ( pos_ == slot.size ) {
+                        if ( slot.last )
+                            eof_ = true;
+                        slot.ready = false;
+                        pos_ = 0;
+                        ++consumed_;
+                        cv_.notify_all();
+                    }
+                }
+                return done;
+            }
+            bool eof() const override { return eof_; }
+            std::string describe() const override { return compressionName( compression_ ) + ", decoded by single thread"; }
+        };
+
+    } // namespace
+
+    Compression detectCompression( std::filesystem::path const& path ) {
+        std::ifstream in( path, std::ios::binary );
+        unsigned char magic[ 4 ] = {};
+        in.read( reinterpret_cast< char* >( magic ), sizeof( magic ) );
+        if ( in.gcount() >= 2 && magic[ 0 ] == 0x1f && magic[ 1 ] == 0x8b )
+            return Compression::Gzip;
+        if ( in.gcount() == 4 ) {
+            auto m = le32( magic );
+            if ( m == 0xFD2FB528 || ( m & 0xFFFFFFF0 ) == 0x184D2A50 ) // frame or skippable frame
+                return Compression::Zstd;
+        }
+        return Compression::None;
+    }
+
+    std::unique_ptr< Input > openInput( std::filesystem::path const& path, [[maybe_unused]] unsigned threads ) {
+        auto compression = detectCompression( path );
+        if ( compression == Compression::Gzip ) {
+#ifdef UWC_HAVE_ZLIB
+            auto file = std::make_unique< MappedFile >( path );
+            auto frames = indexGzipBlocks( *file );
+            if ( decodeInParallel( frames ) )
+                return std::make_unique< ParallelInput >( std::move( file ), compression, std::move( frames ), threads );
+            return std::make_unique< PipelinedInput >( std::make_unique< GzipDecoder >( path ), compression );
+#else
+            throw std::runtime_error( "Built without gzip support (zlib): " + path.string() );
+#endif
+        }
+        if ( compression == Compression::Zstd ) {
+#ifdef UWC_HAVE_ZSTD
+            auto file = std::make_unique< MappedFile >( path );
+            auto frames = indexZstdFrames( *file );
+            if ( decodeInParallel( frames ) )
+                return std::make_unique< ParallelInput >( std::move( file ), compression, std::move( frames ), threads );
+            return std::make_unique< PipelinedInput >( std::make_unique< ZstdDecoder >( path ), compression );
+#else
+            throw std::runtime_error( "Built without zstd support (libzstd): " + path.string() );
+#endif
+        }
+        return std::make_unique< PlainInput >( path );
+    }
+
+    PositionalFile::PositionalFile( std::filesystem::path const& path ) : fd_( ::open( path.c_str(), O_RDONLY ) ) {
+        if ( fd_ < 0 )
+            throw std::runtime_error( "Cannot open input file: " + path.string() );
+        struct stat st;
+        if ( ::fstat( fd_, &st ) != 0 ) {
+            ::close( fd_ );
+            throw std::runtime_error( "Cannot stat input file: " + path.string() );
+        }
+        size_ = static_cast< std::size_t >( st.st_size );
+    }
+
+    PositionalFile::~PositionalFile() { ::close( fd_ ); }
+
+    std::size_t PositionalFile::read( char* dst, std::size_t size, std::size_t offset ) const {
+        std::size_t done = 0;
+        while ( done < size ) {
+            auto n = ::pread( fd_, dst + done, size - done, static_cast< off_t >( offset + done ) );
+            if ( n < 0 ) {
+                if ( errno == EINTR )
+                    continue;
+                throw std::runtime_error( std::string( "Error reading input file: " ) + std::strerror( errno ) );
+            }
+            if ( n == 0 )
+                break;
+            done += static_cast< std::size_t >( n );
+        }
+        return done;
+    }
+
+} // namespace util
@@ -0,0 +1,57 @@
+#ifndef INPUT_HPP
+#define INPUT_HPP
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+namespace util {
+
+    enum class Compression { None, Gzip, Zstd };
+
+    // detect compression from magic bytes at the begining of the file
+    Compression detectCompression( std::filesystem::path const& path );
+
+    // sequential source of (decompressed) input data
+    class Input {
+      public:
+        virtual ~Input() = default;
+
+        // fill dst with up to size bytes, less only at the end of input
+        // return number of bytes stored in dst
+        virtual std::size_t read( char* dst, std::size_t size ) = 0;
+        virtual bool eof() const = 0;
+
+        virtual std::string describe() const = 0; // for verbose output
+    };
+
+    // open plain, gzip or zstd file
+    // Parallel decoding by threads decoders (memory for 2 frames of up to 32MB per decoder) needs independent frames
+    // of known size: gzip only when made of BGZF blocks (bgzip), ordinary gzip files (even multi member ones) are not;
+    // zstd with more than one frame, all with content size in header. Other compressed files are decoded by single
+    // thread pipelined with the reader.
+    // throws std::runtime_error on error, also when reading corrupted or truncated compressed data
+    std::unique_ptr< Input > openInput( std::filesystem::path const& path, unsigned threads );
+
+    // plain file read at given offsets (pread), any number of threads may read it at the same time
+    class PositionalFile {
+      public:
+        explicit PositionalFile( std::filesystem::path const& path ); // throws std::runtime_error
+        ~PositionalFile();
+        PositionalFile( PositionalFile const& ) = delete;
+        PositionalFile& operator=( PositionalFile const& ) = delete;
+
+        // fill dst with up to size bytes from offset, less only at the end of file
+        // return number of bytes stored in dst, throws std::runtime_error on error
+        std::size_t read( char* dst, std::size_t size, std::size_t offset ) const;
+        std::size_t size() const { return size_; }
+
+      private:
+        int fd_;
+        std::size_t size_ = 0;
+    };
+
+} // namespace util
+
+#endif
@@ -0,0 +1,320 @@
+#include "mem.hpp"
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace util {
+
+    namespace {
+        std::atomic< bool > hugePages_{ false };
+        std::atomic< std::size_t > hugetlbPages_{ 0 };
+        std::atomic< std::size_t > adviseBytes_{ 0 };
+
+        std::size_t roundUp( std::size_t x, std::size_t to ) { return ( x + to - 1 ) / to * to; }
+
+        std::size_t pageSize() {
+            static const std::size_t ps = static_cast< std::size_t >( ::sysconf( _SC_PAGESIZE ) );
+            return ps;
+        }
+
+        // mapping length used for given request, must be same in allocLarge() and freeLarge()
+        std::size_t mappedSize( std::size_t size ) {
+            return size >= kHugePage ? roundUp( size, kHugePage ) : roundUp( size, pageSize() );
+        }
+
+        void* mapAnonymous( std::size_t size, int extraFlags ) {
+            void* p = ::mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | extraFlags, -1, 0 );
+            return p == MAP_FAILED ? nullptr : p;
+        }
+
+        // mapping aligned to huge page boundary, so THP can back all of it
+        void* mapAligned( std::size_t size ) {
+            auto raw = static_cast< char* >( mapAnonymous( size + kHugePage, 0 ) );
+            if ( !raw )
+                return nullptr;
+            auto addr = reinterpret_cast< std::uintptr_t >( raw );
+            auto aligned = reinterpret_cast< char* >( roundUp( addr, kHugePage ) );
+            std::size_t head = aligned - raw;
+            if ( head > 0 )
+                ::munmap( raw, head );
+            std::size_t tail = kHugePage - head;
+            if ( tail > 0 )
+                ::munmap( aligned + size, tail );
+            return aligned;
+        }
+
+        // ---------------------------------------------------------------- arena
+        const std::size_t kArenaChunk = 32 * kHugePage;
+        const std::size_t kArenaAlign = 16;
+        const std::size_t kArenaSmallMax = 256;                         // classes by 16 bytes up to here,
+        const std::size_t kArenaLargeMin = kHugePage / 2;               // powers of two below, from here allocLarge()
+        const std::size_t kArenaSmallClasses = kArenaSmallMax / kArenaAlign;
+        const std::size_t kArenaClasses = kArenaSmallClasses + 12;      // 512B .. 1MB
+        const std::uint32_t kSpareBit = std::uint32_t( 1 ) << kArenaClasses;
+        static_assert( ( std::size_t( 2 * kArenaSmallMax ) << 11 ) == kArenaLargeMin );
+
+        std::size_t sizeClass( std::size_t size ) {
+            if ( size <= kArenaSmallMax )
+                return size == 0 ? 0 : ( size - 1 ) / kArenaAlign;
+            return kArenaSmallClasses + static_cast< std::size_t >( std::bit_width( ( size - 1 ) / ( 2 * kArenaSmallMax ) ) );
+        }
+        std::size_t classBytes( std::size_t cls ) {
+            return cls < kArenaSmallClasses ? ( cls + 1 ) * kArenaAlign : ( 2 * kArenaSmallMax ) << ( cls - kArenaSmallClasses );
+        }
+
+        // 2MB frames of chunks, open addressing, entries are never removed (chunks live till exit)
+        const std::size_t kFrameTableSize = 1 << 16; // 128GB of chunks
+        std::atomic< std::uintptr_t > frameTable_[ kFrameTableSize ];
+        std::atomic< bool > haveChunks_{ false };
+        std::atomic< bool > haveLarge_{ false };
+
+        std::size_t frameSlot( std::uintptr_t frame ) {
+            return static_cast< std::size_t >( ( frame * 0x9E3779B97F4A7C15ull ) >> 48 ); // 16 bits
+        }
+        void addFrame( std::uintptr_t frame ) { // called under Chunks::m
+            for ( std::size_t i = frameSlot( frame ), n = 0;; i = ( i + 1 ) & ( kFrameTableSize - 1 ) ) {
+                if ( ++n > kFrameTableSize )
+                    throw std::bad_alloc();
+                if ( frameTable_[ i ].load( std::memory_order_relaxed ) == 0 ) {
+                    frameTable_[ i ].store( frame, std::memory_order_release );
+                    return;
+                }
+            }
+        }
+        bool hasFrame( std::uintptr_t frame ) {
+            for ( std::size_t i = frameSlot( frame ), n = 0; n < kFrameTableSize; i = ( i + 1 ) & ( kFrameTableSize - 1 ), ++n ) {
+                auto f = frameTable_[ i ].load( std::memory_order_acquire );
+                if ( f == frame )
+                    return true;
+                if ( f == 0 )
+                    return false;
+            }
+            return false;
+        }
+
+        struct FreeBlock {
+            FreeBlock* next;
+        };
+        struct ThreadCache {
+            char* cur = nullptr;
+            char* end = nullptr;
+            FreeBlock* free[ kArenaClasses ] = {};
+            bool pooledAtExit = false;
+        };
+        thread_local ThreadCache cache_;
+
+        // bit per class with free lists in pool (kSpareBit: rests of chunks), checked before locking
+        std::atomic< std::uint32_t > pooled_{ 0 };
+
+        struct Chunks {
+            std::mutex m;
+            std::vector< void* > list;
+            std::unordered_set< void* > large;                   // blocks of allocate() from allocLarge()
+            std::vector< FreeBlock* > pool[ kArenaClasses ];     // free lists of exited threads
+            std::vector< std::pair< char*, char* > > spare;      // unused rests of their chunks
+            ~Chunks() {
+                for ( auto p : list )
+                    freeLarge( p, kArenaChunk );
+            }
+            char* get() {
+                auto p = allocLarge( kArenaChunk ); // 2MB aligned
+                std::unique_lock lock( m );
+                list.push_back( p );
+                auto addr = reinterpret_cast< std::uintptr_t >( p );
+                for ( std::size_t off = 0; off < kArenaChunk; off += kHugePage )
+                    addFrame( addr + off );
+                haveChunks_.store( true, std::memory_order_release );
+                return static_cast< char* >( p );
+            }
+            // cache of exiting thread, so memory freed by short lived threads (server connections) is reused
+            void give( ThreadCache& c ) {
+                std::unique_lock lock( m );
+                std::uint32_t bits = 0;
+                for ( std::size_t cls = 0; cls < kArenaClasses; ++cls )
+                    if ( c.free[ cls ] ) {
+                        pool[ cls ].push_back( std::exchange( c.free[ cls ], nullptr ) );
+                        bits |= std::uint32_t( 1 ) << cls;
+                    }
+                if ( c.cur != c.end ) {
+                    spare.emplace_back( c.cur, c.end );
+                    bits |= kSpareBit;
+                }
+                c.cur = c.end = nullptr;
+                pooled_.fetch_or( bits, std::memory_order_relaxed );
+            }
+            FreeBlock* take( std::size_t cls ) {
+                std::unique_lock lock( m );
+                if ( pool[ cls ].empty() )
+                    return nullptr;
+                auto b = pool[ cls ].back();
+                pool[ cls ].pop_back();
+                if ( pool[ cls ].empty() )
+                    pooled_.fetch_and( ~( std::uint32_t( 1 ) << cls ), std::memory_order_relaxed );
+                return b;
+            }
+            bool takeSpare( ThreadCache& c, std::size_t bytes ) {
+                std::unique_lock lock( m );
+                while ( !spare.empty() ) {
+                    auto [ cur, end ] = spare.back();
+                    spare.pop_back(); // too small rest is lost
+                    if ( static_cast< std::size_t >( end - cur ) >= bytes ) {
+                        c.cur = cur;
+                        c.end = end;
+                        break;
+                    }
+                }
+                if ( spare.empty() )
+                    pooled_.fetch_and( ~kSpareBit, std::memory_order_relaxed );
+                return c.cur != c.end;
+            }
+        };
+        Chunks& chunks() {
+            static Chunks c;
+            return c;
+        }
+
+        struct CacheReturn {
+            ~CacheReturn() { chunks().give( cache_ ); }
+        };
+        // register return of cache at thread exit, thread_local with destructor is kept off the fast path
+        void returnAtExit( ThreadCache& c ) {
+            static thread_local CacheReturn r;
+            c.pooledAtExit = true;
+        }
+
+        void refill( ThreadCache& c, std::size_t bytes ) {
+            if ( !c.pooledAtExit )
+                returnAtExit( c );
+            if ( ( pooled_.load( std::memory_order_relaxed ) & kSpareBit ) && chunks().takeSpare( c, bytes ) )
+                return;
+            c.cur = chunks().get(); // rest of previous chunk is lost
+            c.end = c.cur + kArenaChunk;
+        }
+
+    } // namespace
+
+    void enableHugePages( bool on ) { hugePages_.store( on, std::memory_order_relaxed ); }
+    bool hugePagesEnabled() { return hugePages_.load( std::memory_order_relaxed ); }
+
+    void* allocLarge( std::size_t size ) {
+        if ( size == 0 )
+            size = 1;
+        std::size_t len = mappedSize( size );
+        void* p = nullptr;
+        if ( hugePagesEnabled() && size >= kHugePage ) {
+#ifdef MAP_HUGETLB
+            p = mapAnonymous( len, MAP_HUGETLB );
+            if ( p ) {
+                hugetlbPages_.fetch_add( len / kHugePage, std::memory_order_relaxed );
+                return p;
+            }
+#endif
+            p = mapAligned( len );
+#ifdef MADV_HUGEPAGE
+            if ( p && ::madvise( p, len, MADV_HUGEPAGE ) == 0 )
+                adviseBytes_.fetch_add( len, std::memory_order_relaxed );
+#endif
+        } else
+            p = len >= kHugePage ? mapAligned( len ) : mapAnonymous( len, 0 );
+        if ( !p )
+            throw std::bad_alloc();
+        return p;
+    }
+
+    void freeLarge( void* ptr, std::size_t size ) {
+        if ( ptr )
+            ::munmap( ptr, mappedSize( size == 0 ? 1 : size ) );
+    }
+
+    HugePageStats hugePageStats() {
+        HugePageStats stats;
+        stats.hugetlbPages = hugetlbPages_.load( std::memory_order_relaxed );
+        stats.adviseBytes = adviseBytes_.load( std::memory_order_relaxed );
+        std::ifstream smaps( "/proc/self/smaps_rollup" );
+        std::string key;
+        std::size_t kb = 0;
+        while ( smaps >> key ) {
+            if ( key == "AnonHugePages:" ) {
+                smaps >> kb;
+                stats.thpPages = kb * 1024 / kHugePage;
+                break;
+            }
+        }
+        return stats;
+    }
+
+    std::string toString( HugePageStats const& stats ) {
+        return std::to_string( stats.hugetlbPages ) + " explicit (MAP_HUGETLB), " + std::to_string( stats.thpPages )
+            + " transparent (" + std::to_string( stats.adviseBytes / kHugePage ) + " advised)";
+    }
+
+    void* Arena::allocate( std::size_t size ) {
+        if ( size >= kArenaLargeMin ) {
+            auto p = allocLarge( size );
+            auto& c = chunks();
+            std::unique_lock lock( c.m );
+            c.large.insert( p );
+            haveLarge_.store( true, std::memory_order_relaxed );
+            return p;
+        }
+        std::size_t cls = sizeClass( size );
+        auto& c = cache_;
+        if ( !c.free[ cls ] && ( pooled_.load( std::memory_order_relaxed ) & ( std::uint32_t( 1 ) << cls ) ) )
+            c.free[ cls ] = chunks().take( cls );
+        if ( auto b = c.free[ cls ] ) {
+            c.free[ cls ] = b->next;
+            return b;
+        }
+        std::size_t bytes = classBytes( cls );
+        if ( static_cast< std::size_t >( c.end - c.cur ) < bytes )
+            refill( c, bytes );
+        void* p = c.cur;
+        c.cur += bytes;
+        return p;
+    }
+
+    void Arena::deallocate( void* ptr, std::size_t size ) {
+        if ( !ptr )
+            return;
+        if ( size >= kArenaLargeMin ) {
+            {
+                auto& c = chunks();
+                std::unique_lock lock( c.m );
+                c.large.erase( ptr );
+            }
+            freeLarge( ptr, size );
+            return;
+        }
+        auto& c = cache_;
+        if ( !c.pooledAtExit )
+            returnAtExit( c );
+        std::size_t cls = sizeClass( size );
+        auto b = static_cast< FreeBlock* >( ptr );
+        b->next = c.free[ cls ];
+        c.free[ cls ] = b;
+    }
+
+    bool Arena::owns( void* ptr, std::size_t size ) {
+        if ( !ptr )
+            return false;
+        if ( size >= kArenaLargeMin ) {
+            if ( !haveLarge_.load( std::memory_order_relaxed ) )
+                return false;
+            auto& c = chunks();
+            std::unique_lock lock( c.m );
+            return c.large.contains( ptr );
+        }
+        if ( !haveChunks_.load( std::memory_order_acquire ) )
+            return false;
+        return hasFrame( reinterpret_cast< std::uintptr_t >( ptr ) & ~( kHugePage - 1 ) );
+    }
+
+} // namespace util
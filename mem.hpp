@@ -0,0 +1,77 @@
+#ifndef MEM_HPP
+#define MEM_HPP
+
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <string>
+
+namespace util {
+
+    const std::size_t kHugePage = 2 * 1024 * 1024;
+
+    // Enable huge pages for large allocations and the arena below. Affects allocations made afterwards,
+    // memory is always released to the allocator it came from.
+    void enableHugePages( bool on );
+    bool hugePagesEnabled();
+
+    // page aligned allocation straight from mmap (2MB aligned from 2MB up),
+    // with huge pages enabled: MAP_HUGETLB if available, otherwise madvise(MADV_HUGEPAGE)
+    void* allocLarge( std::size_t size );
+    void freeLarge( void* ptr, std::size_t size );
+
+    struct HugePageStats {
+        std::size_t hugetlbPages = 0; // explicit pages (MAP_HUGETLB)
+        std::size_t adviseBytes = 0;  // bytes advised for transparent huge pages
+        std::size_t thpPages = 0;     // transparent huge pages actually backing process memory (AnonHugePages)
+    };
+    HugePageStats hugePageStats();
+    std::string toString( HugePageStats const& stats );
+
+    // Bump allocator for small and medium objects (hash set nodes, word strings, bucket arrays) in size classes
+    // of 16 bytes up to 256, powers of two up to 1MB, bigger blocks are mapped by allocLarge().
+    // Memory comes from large chunks (allocLarge), every thread allocates from its own chunk,
+    // freed blocks go to per thread free lists, which are handed over to other threads when thread exits
+    // together with the rest of its chunk. Chunks are released at process exit only.
+    // Used only when huge pages are enabled, otherwise requests go to global operator new/delete.
+    class Arena {
+      public:
+        static void* allocate( std::size_t size );
+        static void deallocate( void* ptr, std::size_t size );
+        // whether block of given size was allocated by Arena (allocate() might have been called in other mode),
+        // lock free lookup of 2MB frame in table of chunk frames for small blocks, locked set for large ones
+        static bool owns( void* ptr, std::size_t size );
+    };
+
+    // stateless allocator over Arena, so containers using it can exchange nodes (e.g. unordered_set::merge)
+    template< typename T >
+    struct ArenaAllocator {
+        using value_type = T;
+
+        ArenaAllocator() = default;
+        template< typename U >
+        ArenaAllocator( ArenaAllocator< U > const& ) {}
+
+        T* allocate( std::size_t n ) {
+            if ( n > std::numeric_limits< std::size_t >::max() / sizeof( T ) )
+                throw std::bad_array_new_length();
+            if ( !hugePagesEnabled() )
+                return static_cast< T* >( ::operator new( n * sizeof( T ) ) );
+            return static_cast< T* >( Arena::allocate( n * sizeof( T ) ) );
+        }
+        void deallocate( T* ptr, std::size_t n ) {
+            if ( Arena::owns( ptr, n * sizeof( T ) ) )
+                Arena::deallocate( ptr, n * sizeof( T ) );
+            else
+                ::operator delete( ptr );
+        }
+
+        template< typename U >
+        bool operator==( ArenaAllocator< U > const& ) const {
+            return true;
+        }
+    };
+
+} // namespace util
+
+#endif
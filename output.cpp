@@ -0,0 +1,50 @@
+#include "output.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace util {
+
+    Output::Output( std::filesystem::path const& path, std::size_t bufSize ) : path_( path ), buffer_( bufSize ) {
+        fd_ = ::open( path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+        if ( fd_ < 0 )
+            throw std::runtime_error( "Cannot open output file: " + path.string() );
+    }
+
+    Output::~Output() {
+        if ( fd_ >= 0 )
+            ::close( fd_ );
+    }
+
+    void Output::writeAll( std::string_view data ) {
+        while ( !data.empty() ) {
+            auto n = ::write( fd_, data.data(), data.size() );
+            if ( n < 0 ) {
+                if ( errno == EINTR )
+                    continue;
+                throw std::runtime_error( "Error writing output file: " + path_.string() );
+            }
+            data.remove_prefix( static_cast< std::size_t >( n ) );
+            written_ += static_cast< std::size_t >( n );
+        }
+    }
+
+    void Output::flush() {
+        if ( buffer_.valid() == 0 )
+            return;
+        writeAll( buffer_.view() );
+        buffer_.reset();
+    }
+
+    void Output::close() {
+        if ( fd_ < 0 )
+            return;
+        flush();
+        int fd = fd_;
+        fd_ = -1;
+        if ( ::close( fd ) != 0 )
+            throw std::runtime_error( "Error writing output file: " + path_.string() );
+    }
+
+} // namespace util
@@ -0,0 +1,61 @@
+#ifndef OUTPUT_HPP
+#define OUTPUT_HPP
+
+#include "util.hpp"
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <string_view>
+
+namespace util {
+
+    // file written sequentially through one big buffer (allocLarge) by plain write(2) calls,
+    // without iostreams and per call overhead
+    // throws std::runtime_error on error
+    class Output {
+      public:
+        explicit Output( std::filesystem::path const& path, std::size_t bufSize = 16 * kMB );
+        ~Output(); // closes without flushing when close() was not called (e.g. on exception)
+        Output( Output const& ) = delete;
+        Output& operator=( Output const& ) = delete;
+
+        void write( std::string_view data ) {
+            if ( data.size() > buffer_.storageSize() ) {
+                flush();
+                if ( data.size() > buffer_.size() ) {
+                    writeAll( data );
+                    return;
+                }
+            }
+            std::memcpy( buffer_.storageStart(), data.data(), data.size() );
+            buffer_.addValid( data.size() );
+        }
+        void writeLine( std::string_view line ) {
+            if ( line.size() + 1 > buffer_.storageSize() ) {
+                write( line );
+                write( "\n" );
+                return;
+            }
+            char* dst = buffer_.storageStart();
+            std::memcpy( dst, line.data(), line.size() );
+            dst[ line.size() ] = '\n';
+            buffer_.addValid( line.size() + 1 );
+        }
+
+        void flush();
+        void close(); // flush and close file
+
+        std::size_t written() const { return written_ + buffer_.valid(); }
+
+      private:
+        std::filesystem::path path_;
+        int fd_;
+        Buffer buffer_;
+        std::size_t written_ = 0; // bytes passed to write(2)
+
+        void writeAll( std::string_view data );
+    };
+
+} // namespace util
+
+#endif
@@ -0,0 +1,83 @@
+#include "perf.hpp"
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#    include <linux/perf_event.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#endif
+
+namespace util {
+
+    namespace {
+        std::uint64_t now() {
+            return static_cast< std::uint64_t >(
+                std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now().time_since_epoch() )
+                    .count() );
+        }
+
+#ifdef __linux__
+        // type and config of PerfEvent
+        struct EventConfig {
+            std::uint32_t type;
+            std::uint64_t config;
+        };
+        const std::array< EventConfig, kPerfEvents > kEventConfigs = { {
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+            { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | ( PERF_COUNT_HW_CACHE_OP_READ << 8 )
+                                      | ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 ) },
+        } };
+#endif
+    } // namespace
+
+    PerfCounters::PerfCounters() {
+        fds_.fill( -1 );
+#ifdef __linux__
+        for ( std::size_t i = 0; i < fds_.size(); ++i ) {
+            perf_event_attr attr;
+            std::memset( &attr, 0, sizeof( attr ) );
+            attr.size = sizeof( attr );
+            attr.type = kEventConfigs[ i ].type;
+            attr.config = kEventConfigs[ i ].config;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            // calling thread on any CPU
+            fds_[ i ] = static_cast< int >( ::syscall( SYS_perf_event_open, &attr, 0, -1, -1, 0 ) );
+            if ( fds_[ i ] < 0 && error_.empty() )
+                error_ = std::string( "perf_event_open " ) + kPerfEventNames[ i ] + ": " + std::strerror( errno );
+        }
+#else
+        error_ = "perf_event_open is not supported on this platform";
+#endif
+    }
+
+    PerfCounters::~PerfCounters() {
+#ifdef __linux__
+        for ( int fd : fds_ )
+            if ( fd >= 0 )
+                ::close( fd );
+#endif
+    }
+
+    PerfCounts PerfCounters::read() const {
+        PerfCounts res;
+#ifdef __linux__
+        for ( std::size_t i = 0; i < fds_.size(); ++i ) {
+            std::uint64_t data[ 3 ]; // value, time enabled, time running
+            if ( fds_[ i ] < 0 || ::read( fds_[ i ], data, sizeof( data ) ) != sizeof( data ) || data[ 2 ] == 0 )
+                continue;
+            res.events[ i ] = data[ 2 ] < data[ 1 ]
+                                  ? static_cast< std::uint64_t >( static_cast< double >( data[ 0 ] ) * data[ 1 ] / data[ 2 ] )
+                                  : data[ 0 ];
+        }
+#endif
+        res.nanoseconds = now();
+        return res;
+    }
+
+} // namespace util
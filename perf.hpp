@@ -0,0 +1,75 @@
+#ifndef PERF_HPP
+#define PERF_HPP
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace util {
+
+    // hardware events counted by PerfCounters
+    enum PerfEvent { Cycles, Instructions, LlcMisses, BranchMisses, DtlbMisses, kPerfEvents };
+    inline constexpr std::array< char const*, kPerfEvents > kPerfEventNames = {
+        "cycles", "instructions", "LLC-misses", "branch-misses", "dTLB-misses" };
+
+    // event counts and elapsed time, summed over phases or threads
+    struct PerfCounts {
+        std::array< std::uint64_t, kPerfEvents > events{};
+        std::uint64_t nanoseconds = 0;
+
+        PerfCounts& operator+=( PerfCounts const& other ) {
+            for ( std::size_t i = 0; i < events.size(); ++i )
+                events[ i ] += other.events[ i ];
+            nanoseconds += other.nanoseconds;
+            return *this;
+        }
+    };
+
+    // Hardware counters of the calling thread (perf_event_open on Linux, user space only), one file descriptor per
+    // event. Events the kernel forbids (perf_event_paranoid) or the CPU lacks stay unavailable and read as 0;
+    // counts of multiplexed events are scaled by time they were running.
+    class PerfCounters {
+      public:
+        PerfCounters();
+        ~PerfCounters();
+        PerfCounters( PerfCounters const& ) = delete;
+        PerfCounters& operator=( PerfCounters const& ) = delete;
+
+        PerfCounts read() const; // totals since construction, nanoseconds is current time
+        bool available( PerfEvent event ) const { return fds_[ event ] >= 0; }
+        std::string const& error() const { return error_; } // why first unavailable event failed
+
+      private:
+        std::array< int, kPerfEvents > fds_;
+        std::string error_;
+    };
+
+    // adds counts of calling thread during its lifetime to sum, does nothing if counters is null
+    class PerfScope {
+      public:
+        PerfScope( PerfCounters const* counters, PerfCounts& sum ) : counters_( counters ), sum_( sum ) {
+            if ( counters_ )
+                start_ = counters_->read();
+        }
+        ~PerfScope() {
+            if ( !counters_ )
+                return;
+            auto stop = counters_->read();
+            for ( std::size_t i = 0; i < stop.events.size(); ++i ) // scaled counts may step back a bit
+                sum_.events[ i ] += stop.events[ i ] > start_.events[ i ] ? stop.events[ i ] - start_.events[ i ] : 0;
+            sum_.nanoseconds += stop.nanoseconds - start_.nanoseconds;
+        }
+        PerfScope( PerfScope const& ) = delete;
+        PerfScope& operator=( PerfScope const& ) = delete;
+
+      private:
+        PerfCounters const* counters_;
+        PerfCounts& sum_;
+        PerfCounts start_;
+    };
+
+} // namespace util
+
+#endif
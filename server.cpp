@@ -0,0 +1,318 @@
+#include "server.hpp"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+namespace uwc {
+
+    namespace {
+        std::atomic< bool > signalled_{ false };
+        void onSignal( int ) { signalled_ = true; }
+
+        const std::size_t kRecvSize = 4 * util::kMB;
+        const std::size_t kMaxConnections = 256; // connection threads, requests are limited by slots and queue
+
+        sockaddr_un address( std::filesystem::path const& socket ) {
+            sockaddr_un addr{};
+            addr.sun_family = AF_UNIX;
+            auto s = socket.string();
+            if ( s.size() >= sizeof( addr.sun_path ) )
+                throw std::runtime_error( "Socket path too long: " + s );
+            std::memcpy( addr.sun_path, s.c_str(), s.size() + 1 );
+            return addr;
+        }
+
+        void sendAll( int fd, std::string_view data ) {
+            while ( !data.empty() ) {
+                auto n = ::send( fd, data.data(), data.size(), MSG_NOSIGNAL );
+                if ( n < 0 && errno == EINTR )
+                    continue;
+                if ( n <= 0 )
+                    throw std::runtime_error( "Connection lost" );
+                data.remove_prefix( n );
+            }
+        }
+
+        // buffered reading from socket
+        class Reader {
+            int fd_;
+            std::vector< char > buf_;
+            std::size_t begin_ = 0, end_ = 0;
+
+            bool fill() {
+                if ( begin_ == end_ )
+                    begin_ = end_ = 0;
+                else if ( end_ == buf_.size() ) {
+                    std::memmove( buf_.data(), buf_.data() + begin_, end_ - begin_ );
+                    end_ -= begin_;
+                    begin_ = 0;
+                }
+                while ( true ) {
+                    auto n = ::recv( fd_, buf_.data() + end_, buf_.size() - end_, 0 );
+                    if ( n < 0 && errno == EINTR )
+                        continue;
+                    if ( n <= 0 )
+                        return false;
+                    end_ += n;
+                    return true;
+                }
+            }
+
+          public:
+            explicit Reader( int fd ) : fd_( fd ), buf_( kRecvSize ) {}
+
+            // false at end of connection
+            bool line( std::string& out ) {
+                out.clear();
+                while ( true ) {
+                    std::string_view avail( buf_.data() + begin_, end_ - begin_ );
+                    auto pos = avail.find( '\n' );
+                    if ( pos != std::string_view::npos ) {
+                        out.append( avail.substr( 0, pos ) );
+                        begin_ += pos + 1;
+                        return true;
+                    }
+                    out.append( avail );
+                    begin_ = end_;
+                    if ( out.size() > 64 * util::kKB )
+                        throw std::runtime_error( "Request line too long" );
+                    if ( !fill() )
+                        return false;
+                }
+            }
+
+            // pass size bytes to sink in pieces as they arrive, without copying
+            template< typename SINK >
+            void bytes( std::size_t size, SINK&& sink ) {
+                while ( size > 0 ) {
+                    if ( begin_ == end_ && !fill() )
+                        throw std::runtime_error( "Connection lost" );
+                    std::size_t n = std::min( size, end_ - begin_ );
+                    sink( std::string_view( buf_.data() + begin_, n ) );
+                    begin_ += n;
+                    size -= n;
+                }
+            }
+        };
+
+        std::size_t parseSize( std::string const& text ) {
+            std::size_t count = 0, size = 0;
+            try {
+                size = std::stoull( text, &count, 10 );
+            } catch ( std::exception const& ) {
+            }
+            if ( count == 0 || count != text.size() )
+                throw std::runtime_error( "Bad size '" + text + "'" );
+            return size;
+        }
+    } // namespace
+
+    Server::Server(
+        std::filesystem::path socket, unsigned slots, std::size_t maxQueue, SlotFactory const& factory, bool verbose )
+        : socket_( std::move( socket ) ), maxQueue_( maxQueue ), verbose_( verbose ) {
+        for ( unsigned i = 0; i < std::max( 1u, slots ); ++i ) {
+            slots_.push_back( factory() );
+            free_.push_back( slots_.back().get() );
+        }
+    }
+
+    Server::~Server() {
+        std::unique_lock lock( m_ );
+        while ( connections_ > 0 ) // connection threads are detached, slots must outlive them
+            cv_.wait( lock );
+    }
+
+    Slot* Server::acquire() {
+        std::unique_lock lock( m_ );
+        if ( free_.empty() && waiting_ >= maxQueue_ )
+            return nullptr;
+        ++waiting_;
+        while ( free_.empty() )
+            cv_.wait( lock );
+        --waiting_;
+        auto slot = free_.back();
+        free_.pop_back();
+        return slot;
+    }
+
+    void Server::release( Slot* slot ) {
+        std::unique_lock lock( m_ );
+        free_.push_back( slot );
+        cv_.notify_all();
+    }
+
+    void Server::stop() { stop_ = true; }
+
+    void Server::run() {
+        auto addr = address( socket_ );
+        int listenFd = ::socket( AF_UNIX, SOCK_STREAM, 0 );
+        if ( listenFd < 0 )
+            throw std::runtime_error( std::string( "Cannot create socket: " ) + std::strerror( errno ) );
+        ::unlink( socket_.c_str() );
+        // socket is accessible to owner only before anybody can connect, FILE requests read with rights of the server
+        if ( ::bind( listenFd, reinterpret_cast< sockaddr* >( &addr ), sizeof( addr ) ) < 0
+             || ::chmod( socket_.c_str(), S_IRUSR | S_IWUSR ) < 0 || ::listen( listenFd, 64 ) < 0 ) {
+            ::close( listenFd );
+            throw std::runtime_error( "Cannot listen on " + socket_.string() + ": " + std::strerror( errno ) );
+        }
+        std::signal( SIGINT, onSignal );
+        std::signal( SIGTERM, onSignal );
+        if ( verbose_ )
+            std::cout << "Serving on " << socket_.string() << " with " << slots_.size() << " slots" << std::endl;
+
+        while ( !stop_ && !signalled_ ) {
+            pollfd pfd{ listenFd, POLLIN, 0 };
+            if ( ::poll( &pfd, 1, 200 ) <= 0 )
+                continue;
+            int fd = ::accept( listenFd, nullptr, nullptr );
+            if ( fd < 0 )
+                continue;
+            {
+                std::unique_lock lock( m_ );
+                if ( connections_ >= kMaxConnections ) {
+                    lock.unlock();
+                    try {
+                        sendAll( fd, "BUSY\n" );
+                    } catch ( std::exception const& ) {
+                    }
+                    ::close( fd );
+                    continue;
+                }
+                ++connections_;
+                fds_.insert( fd );
+            }
+            std::thread( [ this, fd ] {
+                serve( fd );
+                std::unique_lock lock( m_ );
+                fds_.erase( fd ); // under lock, so run() never shuts down reused descriptor
+                ::close( fd );
+                --connections_;
+                cv_.notify_all();
+            } ).detach();
+        }
+        ::close( listenFd );
+        ::unlink( socket_.c_str() );
+        {
+            // wake connection threads blocked in recv, requests in progress end with "Connection lost"
+            std::unique_lock lock( m_ );
+            for ( int fd : fds_ )
+                ::shutdown( fd, SHUT_RDWR );
+        }
+        if ( verbose_ )
+            std::cout << "Server stopped" << std::endl;
+    }
+
+    void Server::serve( int fd ) {
+        Reader reader( fd );
+        std::string line;
+        try {
+            while ( reader.line( line ) ) {
+                if ( line == "QUIT" )
+                    return;
+                auto startTime = std::chrono::steady_clock::now();
+                auto space = line.find( ' ' );
+                std::string cmd = line.substr( 0, space ), arg = space == npos ? "" : line.substr( space + 1 );
+                if ( cmd != "FILE" && cmd != "DATA" && cmd != "STREAM" ) {
+                    sendAll( fd, "ERROR Unknown request '" + cmd + "'\n" );
+                    return;
+                }
+                auto slot = acquire();
+                if ( !slot ) {
+                    sendAll( fd, "BUSY\n" );
+                    return; // data of DATA/STREAM request was not read, connection cannot continue
+                }
+                std::string response;
+                bool failed = false;
+                try {
+                    if ( cmd == "FILE" )
+                        slot->feedFile( arg );
+                    else if ( cmd == "DATA" )
+                        reader.bytes( parseSize( arg ), [ slot ]( std::string_view d ) { slot->feed( d ); } );
+                    else
+                        while ( true ) {
+                            if ( !reader.line( line ) )
+                                throw std::runtime_error( "Connection lost" );
+                            auto size = parseSize( line );
+                            if ( size == 0 )
+                                break;
+                            reader.bytes( size, [ slot ]( std::string_view d ) { slot->feed( d ); } );
+                        }
+                    response = "OK " + std::to_string( slot->count() ) + "\n";
+                } catch ( std::exception const& e ) {
+                    response = std::string( "ERROR " ) + e.what() + "\n";
+                    failed = true;
+                }
+                std::chrono::duration< float, std::milli > ms = std::chrono::steady_clock::now() - startTime;
+                try {
+                    sendAll( fd, response );
+                } catch ( ... ) {
+                    slot->reset();
+                    release( slot );
+                    throw;
+                }
+                // clean slot for next request after client got its answer
+                slot->reset();
+                release( slot );
+                if ( verbose_ )
+                    std::cout << cmd << " " << arg << " -> " << response.substr( 0, response.size() - 1 ) << " in " << ms.count()
+                              << " ms" << std::endl;
+                if ( failed && cmd != "FILE" )
+                    return; // unread data of failed DATA/STREAM request would be taken as next requests
+            }
+        } catch ( std::exception const& e ) {
+            if ( verbose_ )
+                std::cout << "Connection error: " << e.what() << std::endl;
+        }
+    }
+
+    std::string requestCount( std::filesystem::path const& socket, std::filesystem::path const& path ) {
+        auto addr = address( socket );
+        int fd = ::socket( AF_UNIX, SOCK_STREAM, 0 );
+        if ( fd < 0 || ::connect( fd, reinterpret_cast< sockaddr* >( &addr ), sizeof( addr ) ) < 0 ) {
+            if ( fd >= 0 )
+                ::close( fd );
+            throw std::runtime_error( "Cannot connect to " + socket.string() + ": " + std::strerror( errno ) );
+        }
+        std::string response;
+        Reader reader( fd );
+        try {
+            if ( path == "-" ) {
+                sendAll( fd, "STREAM\n" );
+                std::vector< char > buf( kRecvSize );
+                while ( std::cin ) {
+                    std::cin.read( buf.data(), buf.size() );
+                    std::size_t n = std::cin.gcount();
+                    if ( n == 0 )
+                        break;
+                    sendAll( fd, std::to_string( n ) + "\n" );
+                    sendAll( fd, std::string_view( buf.data(), n ) );
+                }
+                sendAll( fd, "0\n" );
+            } else
+                sendAll( fd, "FILE " + std::filesystem::absolute( path ).string() + "\n" );
+            if ( !reader.line( response ) )
+                throw std::runtime_error( "No response from server" );
+            sendAll( fd, "QUIT\n" );
+        } catch ( ... ) {
+            // server may have rejected request (BUSY) and closed connection before whole request was sent
+            bool answered = !response.empty() || reader.line( response );
+            ::close( fd );
+            if ( answered )
+                return response;
+            throw;
+        }
+        ::close( fd );
+        return response;
+    }
+
+} // namespace uwc
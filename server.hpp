@@ -0,0 +1,93 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include "counter.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace uwc {
+
+    // Counter kept warm between requests of the server
+    class Slot {
+      public:
+        virtual ~Slot() = default;
+        virtual void reset() = 0;
+        virtual void feedFile( std::filesystem::path const& path ) = 0;
+        virtual void feed( std::string_view data ) = 0;
+        virtual std::size_t count() = 0;
+    };
+
+    template< typename Engine, typename Aggregation, typename Delims = util::WhitespaceDelimiters >
+    class CounterSlot : public Slot {
+        Counter< Engine, Aggregation, Delims > counter_;
+
+      public:
+        CounterSlot( unsigned threads, std::size_t inBufSize, std::size_t reserve, unsigned shortWords = 0 )
+            : counter_( threads, inBufSize ) {
+            counter_.useShortWords( shortWords );
+            counter_.reserve( reserve );
+        }
+        void reset() override { counter_.reset(); }
+        void feedFile( std::filesystem::path const& path ) override { counter_.feedFile( path ); }
+        void feed( std::string_view data ) override { counter_.feed( data ); }
+        std::size_t count() override { return counter_.count(); }
+    };
+
+    // Unix socket server counting unique words for clients, line based protocol:
+    //   FILE <path>\n                  -> count words in file (plain or compressed)
+    //   DATA <size>\n<size bytes>      -> count words in sent bytes
+    //   STREAM\n(<size>\n<size bytes>)* 0\n -> count words in sent chunks
+    //   QUIT\n                         -> close connection
+    // each request is answered by "OK <count>\n", "BUSY\n" or "ERROR <message>\n",
+    // connection is closed after BUSY and after ERROR of DATA/STREAM (rest of sent data cannot be skipped reliably)
+    // Requests are processed concurrently by slots (each with own worker threads),
+    // up to maxQueue requests wait for free slot, others are rejected as BUSY.
+    // Socket is created with mode 0600: FILE opens any path with privileges of the server process,
+    // so only its owner may connect.
+    class Server {
+      public:
+        using SlotFactory = std::function< std::unique_ptr< Slot >() >;
+
+        Server( std::filesystem::path socket, unsigned slots, std::size_t maxQueue, SlotFactory const& factory, bool verbose );
+        ~Server();
+
+        // accept connections until SIGINT/SIGTERM or stop(), then shut down open connections,
+        // throws std::runtime_error if socket cannot be created
+        void run();
+        void stop(); // can be called from any thread
+
+      private:
+        std::filesystem::path socket_;
+        std::size_t maxQueue_;
+        bool verbose_;
+        std::vector< std::unique_ptr< Slot > > slots_;
+
+        std::mutex m_;
+        std::condition_variable cv_;
+        std::vector< Slot* > free_;
+        std::size_t waiting_ = 0;
+        std::size_t connections_ = 0;
+        std::set< int > fds_; // open connections, shut down when server stops
+        std::atomic< bool > stop_{ false };
+
+        Slot* acquire(); // nullptr if too many requests are waiting
+        void release( Slot* slot );
+        void serve( int fd );
+    };
+
+    // send request to server, return its response without newline
+    // path "-" streams standard input, throws std::runtime_error on connection error
+    std::string requestCount( std::filesystem::path const& socket, std::filesystem::path const& path );
+
+} // namespace uwc
+
+#endif
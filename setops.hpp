@@ -0,0 +1,104 @@
+#ifndef SETOPS_HPP
+#define SETOPS_HPP
+
+#include "counter.hpp"
+#include "dump.hpp"
+#include "sketch.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <utility>
+
+namespace uwc {
+
+    // Numbers of unique words of two inputs and of words common to both, inexact ones are estimated from sketches.
+    struct Comparison {
+        double first = 0;
+        double second = 0;
+        double common = 0;
+        bool firstExact = true;
+        bool secondExact = true;
+        bool commonExact = true;
+
+        double onlyFirst() const { return std::max( 0.0, first - common ); } // words of first not in second
+        double onlySecond() const { return std::max( 0.0, second - common ); }
+        bool onlyFirstExact() const { return firstExact && commonExact; }
+        bool onlySecondExact() const { return secondExact && commonExact; }
+        double jaccard() const { // common / all words, 1 for two empty inputs
+            double all = first + second - common;
+            return all > 0 ? common / all : 1;
+        }
+        bool jaccardExact() const { return firstExact && secondExact && commonExact; }
+    };
+
+    // operand of comparison: word list saved by dumpWords() (.uwi), saved Sketch (.hll) or any other input
+    inline bool isIndex( std::filesystem::path const& path ) { return path.extension() == ".uwi"; }
+    inline bool isSketch( std::filesystem::path const& path ) { return path.extension() == ".hll"; }
+
+    namespace detail {
+        template< typename Counter >
+        void feedOperand( Counter& counter, std::filesystem::path const& path ) {
+            if ( isIndex( path ) )
+                loadIndex( counter, path );
+            else
+                counter.feedFile( path );
+        }
+
+        // sketch of all words of operand, no set is built
+        template< typename Engine, typename Aggregation, typename Delims >
+        Sketch sketchOf( std::filesystem::path const& path, std::size_t inBufSize ) {
+            if ( isSketch( path ) )
+                return Sketch::load( path );
+            typename Engine::Set none;
+            Counter< Engine, Aggregation, Delims > counter( 0, inBufSize );
+            counter.useReference( Reference< typename Engine::Set >{ &none } );
+            feedOperand( counter, path );
+            counter.count();
+            return counter.sketch();
+        }
+    } // namespace detail
+
+    // Compare unique words of two operands in one pass over each of them. Unique words of the smaller one (by file
+    // size) are counted exactly, the bigger one is fed to a counter probing them read only (Counter::useReference()),
+    // which marks words found by bits over positions of the smaller set instead of copying them, so words common to
+    // both are exact and memory is proportional to the smaller operand; words found only in the bigger one are
+    // estimated by sketch. If any operand is a sketch, all numbers are estimated from sketches.
+    // throws std::runtime_error if an operand cannot be read
+    template< typename Engine, typename Aggregation, typename Delims >
+    Comparison compare( std::filesystem::path const& first, std::filesystem::path const& second, unsigned shortWords,
+                        std::size_t inBufSize = Counter< Engine, Aggregation, Delims >::kDefaultInBufSize ) {
+        Comparison res;
+        if ( isSketch( first ) || isSketch( second ) ) {
+            auto a = detail::sketchOf< Engine, Aggregation, Delims >( first, inBufSize );
+            auto b = detail::sketchOf< Engine, Aggregation, Delims >( second, inBufSize );
+            res.first = a.estimate();
+            res.second = b.estimate();
+            a.merge( b );
+            res.common = std::max( 0.0, res.first + res.second - a.estimate() );
+            res.firstExact = res.secondExact = res.commonExact = false;
+            return res;
+        }
+
+        bool swapped = std::filesystem::file_size( second ) < std::filesystem::file_size( first );
+        Counter< Engine, Aggregation, Delims > small( 0, inBufSize );
+        small.useShortWords( shortWords );
+        detail::feedOperand( small, swapped ? second : first );
+        res.first = static_cast< double >( small.count() );
+
+        Counter< Engine, Aggregation, Delims > big( 0, inBufSize ); // marks short words in bitmap of reference hits
+        big.useReference( small.reference() );
+        detail::feedOperand( big, swapped ? first : second );
+        res.common = static_cast< double >( big.count() );
+        double rest = big.sketch().estimate();
+        res.second = res.common + rest;
+        res.secondExact = rest == 0;
+        if ( swapped ) {
+            std::swap( res.first, res.second );
+            std::swap( res.firstExact, res.secondExact );
+        }
+        return res;
+    }
+
+} // namespace uwc
+
+#endif
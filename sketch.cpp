@@ -0,0 +1,78 @@
+#include "sketch.hpp"
+#include "output.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace uwc {
+
+    namespace {
+        const std::string_view kMagic = "uwc-hll1"; // file header, followed by precision byte and registers
+    }
+
+    Sketch::Sketch( unsigned precision ) : precision_( precision ) {
+        if ( precision < kMinPrecision || precision > kMaxPrecision )
+            throw std::invalid_argument( "Bad sketch precision " + std::to_string( precision ) + ", should be in range "
+                                         + std::to_string( kMinPrecision ) + " .. " + std::to_string( kMaxPrecision ) );
+        registers_.resize( std::size_t( 1 ) << precision );
+    }
+
+    void Sketch::merge( Sketch const& other ) {
+        if ( other.precision_ != precision_ )
+            throw std::invalid_argument( "Cannot merge sketches of precision " + std::to_string( precision_ ) + " and "
+                                         + std::to_string( other.precision_ ) );
+        for ( std::size_t i = 0; i < registers_.size(); ++i )
+            registers_[ i ] = std::max( registers_[ i ], other.registers_[ i ] );
+    }
+
+    double Sketch::estimate() const {
+        auto m = static_cast< double >( registers_.size() );
+        double sum = 0;
+        std::size_t zeros = 0;
+        for ( auto reg : registers_ ) {
+            sum += std::ldexp( 1.0, -reg );
+            zeros += reg == 0;
+        }
+        double alpha = registers_.size() == 16 ? 0.673
+                       : registers_.size() == 32 ? 0.697
+                       : registers_.size() == 64 ? 0.709
+                                                 : 0.7213 / ( 1 + 1.079 / m );
+        double raw = alpha * m * m / sum;
+        // linear counting is more precise while many registers are empty, 64 bit hashes need no large range correction
+        if ( raw <= 2.5 * m && zeros > 0 )
+            return m * std::log( m / static_cast< double >( zeros ) );
+        return raw;
+    }
+
+    void Sketch::clear() { std::fill( registers_.begin(), registers_.end(), 0 ); }
+
+    void Sketch::save( std::filesystem::path const& path ) const {
+        util::Output out( path, kMagic.size() + 1 + registers_.size() );
+        out.write( kMagic );
+        char precision = static_cast< char >( precision_ );
+        out.write( { &precision, 1 } );
+        out.write( { reinterpret_cast< char const* >( registers_.data() ), registers_.size() } );
+        out.close();
+    }
+
+    Sketch Sketch::load( std::filesystem::path const& path ) {
+        std::ifstream in( path, std::ios::binary );
+        if ( !in )
+            throw std::runtime_error( "Cannot open sketch file: " + path.string() );
+        std::string magic( kMagic.size(), 0 );
+        char precision = 0;
+        if ( !in.read( magic.data(), static_cast< std::streamsize >( magic.size() ) ) || magic != kMagic
+             || !in.get( precision ) || static_cast< unsigned >( precision ) < kMinPrecision
+             || static_cast< unsigned >( precision ) > kMaxPrecision )
+            throw std::runtime_error( "Not a sketch file: " + path.string() );
+        Sketch res( static_cast< unsigned >( precision ) );
+        auto size = static_cast< std::streamsize >( res.registers_.size() );
+        if ( !in.read( reinterpret_cast< char* >( res.registers_.data() ), size )
+             || in.peek() != std::ifstream::traits_type::eof() )
+            throw std::runtime_error( "Corrupted sketch file: " + path.string() );
+        return res;
+    }
+
+} // namespace uwc
@@ -0,0 +1,54 @@
+#ifndef SKETCH_HPP
+#define SKETCH_HPP
+
+#include "hash.hpp"
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+namespace uwc {
+
+    // HyperLogLog estimate of number of distinct words: 2^precision one byte registers keep the longest run of
+    // leading zeros (+1) of hashes falling to them. Standard error is 1.04 / sqrt( 2^precision ), 0.8% for default
+    // precision 14 (16KB). Words are hashed by hash::Wy, so sketches of different builds and runs can be merged.
+    class Sketch {
+      public:
+        static constexpr unsigned kMinPrecision = 4;
+        static constexpr unsigned kMaxPrecision = 18;
+        static constexpr unsigned kDefaultPrecision = 14;
+
+        // throws std::invalid_argument if precision is out of kMinPrecision .. kMaxPrecision
+        explicit Sketch( unsigned precision = kDefaultPrecision );
+
+        void add( std::string_view word ) { addHash( hash::Wy::hash( word ) ); }
+        void addHash( std::uint64_t hash ) {
+            auto& reg = registers_[ hash >> ( 64 - precision_ ) ];
+            // bit below index bits stops the count, so rank is at most 64 - precision + 1
+            auto rank = static_cast< std::uint8_t >(
+                std::countl_zero( ( hash << precision_ ) | ( std::uint64_t( 1 ) << ( precision_ - 1 ) ) ) + 1 );
+            if ( rank > reg )
+                reg = rank;
+        }
+
+        // union of both sketches, throws std::invalid_argument if precisions differ
+        void merge( Sketch const& other );
+
+        double estimate() const;
+        unsigned precision() const { return precision_; }
+        void clear();
+
+        // throws std::runtime_error if file cannot be written / read or is not a sketch
+        void save( std::filesystem::path const& path ) const;
+        static Sketch load( std::filesystem::path const& path );
+
+      private:
+        unsigned precision_;
+        std::vector< std::uint8_t > registers_;
+    };
+
+} // namespace uwc
+
+#endif
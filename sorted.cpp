@@ -0,0 +1,121 @@
+#include "sorted.hpp"
+#include <cstring>
+
+namespace uwc {
+
+    namespace {
+        const std::size_t kSmallSort = 64; // buckets up to this size are sorted by std::sort
+
+        inline unsigned digit( Key key, unsigned byte ) { return static_cast< unsigned >( key >> ( 8 * byte ) ) & 0xff; }
+
+        void msdSort( Key* keys, Key* tmp, std::size_t n, unsigned byte ) {
+            if ( n <= kSmallSort ) {
+                std::sort( keys, keys + n );
+                return;
+            }
+            std::size_t count[ 256 ] = {};
+            for ( std::size_t i = 0; i < n; ++i )
+                ++count[ digit( keys[ i ], byte ) ];
+
+            if ( count[ digit( keys[ 0 ], byte ) ] < n ) { // otherwise all keys share this byte
+                std::size_t offset[ 256 ];
+                std::size_t sum = 0;
+                for ( unsigned b = 0; b < 256; ++b ) {
+                    offset[ b ] = sum;
+                    sum += count[ b ];
+                }
+                for ( std::size_t i = 0; i < n; ++i )
+                    tmp[ offset[ digit( keys[ i ], byte ) ]++ ] = keys[ i ];
+                std::memcpy( static_cast< void* >( keys ), tmp, n * sizeof( Key ) );
+            }
+            if ( byte == 0 )
+                return;
+            std::size_t start = 0;
+            for ( unsigned b = 0; b < 256; ++b ) {
+                if ( count[ b ] > 1 )
+                    msdSort( keys + start, tmp + start, count[ b ], byte - 1 );
+                start += count[ b ];
+            }
+        }
+    } // namespace
+
+    std::size_t unpack( Key key, char* out ) {
+        std::size_t len = 0;
+        for ( ; len < kMaxPacked; ++len ) {
+            unsigned code = static_cast< unsigned >( key >> 123 );
+            if ( code == 0 )
+                break;
+            out[ len ] = static_cast< char >( 'a' - 1 + code );
+            key <<= 5;
+        }
+        return len;
+    }
+
+    void radixSort( Key* keys, Key* tmp, std::size_t n ) {
+        if ( n > 1 )
+            msdSort( keys, tmp, n, sizeof( Key ) - 1 );
+    }
+
+    void SortedWords::compact() {
+        if ( sorted_ == keys_.size() )
+            return;
+        std::size_t tail = keys_.size() - sorted_;
+        if ( tmp_.size() < keys_.size() )
+            tmp_.resize( keys_.size() );
+        radixSort( keys_.data() + sorted_, tmp_.data(), tail );
+        auto end = std::unique( keys_.begin() + sorted_, keys_.end() );
+        if ( sorted_ > 0 ) {
+            end = std::set_union( keys_.begin(), keys_.begin() + sorted_, keys_.begin() + sorted_, end, tmp_.begin() );
+            std::size_t size = end - tmp_.begin();
+            std::swap( keys_, tmp_ );
+            keys_.resize( size );
+        } else
+            keys_.erase( end, keys_.end() );
+        sorted_ = keys_.size();
+    }
+
+    void SortedWords::merge( SortedWords& other ) {
+        if ( !other.keys_.empty() ) {
+            if ( keys_.empty() ) {
+                std::swap( keys_, other.keys_ );
+                std::swap( sorted_, other.sorted_ );
+            } else {
+                compact();
+                other.compact();
+                tmp_.resize( keys_.size() + other.keys_.size() );
+                auto end = std::set_union( keys_.begin(), keys_.end(), other.keys_.begin(), other.keys_.end(), tmp_.begin() );
+                tmp_.erase( end, tmp_.end() );
+                std::swap( keys_, tmp_ );
+                sorted_ = keys_.size();
+            }
+        }
+        others_.merge( other.others_ );
+        other.clear();
+    }
+
+    bool SortedWords::contains( std::string_view word ) const {
+        Key key;
+        if ( !pack( word, key ) )
+            return others_.contains( std::string( word ) );
+        assert( compacted() );
+        return std::binary_search( keys_.begin(), keys_.end(), key );
+    }
+
+    std::size_t SortedWords::position( std::string_view word ) const {
+        assert( compacted() );
+        Key key;
+        if ( !pack( word, key ) ) {
+            auto pos = bucketPosition( others_, word );
+            return pos == std::string_view::npos ? pos : keys_.size() + pos;
+        }
+        auto it = std::lower_bound( keys_.begin(), keys_.end(), key );
+        return it != keys_.end() && *it == key ? static_cast< std::size_t >( it - keys_.begin() ) : std::string_view::npos;
+    }
+
+    void SortedWords::clear() {
+        keys_.clear();
+        sorted_ = 0;
+        others_.clear();
+    }
+
+} // namespace uwc
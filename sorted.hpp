@@ -0,0 +1,119 @@
+#ifndef SORTED_HPP
+#define SORTED_HPP
+
+#include "hash.hpp"
+#include "mem.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace uwc {
+
+    // Word of up to kMaxPacked letters 'a'..'z' packed to 128 bit integer, 5 bits per letter
+    // from the most significant bits, unused bits are zero -> keys compare like words.
+    __extension__ typedef unsigned __int128 Key;
+
+    const std::size_t kMaxPacked = 25;
+
+    // false if word is empty, too long or contains other characters than 'a'..'z'
+    inline bool pack( std::string_view word, Key& key ) {
+        if ( word.empty() || word.size() > kMaxPacked )
+            return false;
+        Key k = 0;
+        for ( char c : word ) {
+            unsigned code = static_cast< unsigned char >( c ) - ( 'a' - 1 );
+            if ( code - 1 > 25 )
+                return false;
+            k = ( k << 5 ) | code;
+        }
+        key = k << ( 128 - 5 * word.size() );
+        return true;
+    }
+
+    // write word to out (at least kMaxPacked chars), return its length
+    std::size_t unpack( Key key, char* out );
+
+    // sort n keys in place, tmp is scratch space for n keys
+    // MSD radix sort by bytes, small buckets are finished by std::sort
+    void radixSort( Key* keys, Key* tmp, std::size_t n );
+
+    // Set of words for sort engine: workers only append packed keys, duplicates are removed by sorting.
+    // Keys are kept as sorted unique prefix followed by unsorted tail, tail is sorted and merged
+    // into prefix whenever it grows bigger than prefix (and on compact() / merge()), so memory stays
+    // proportional to number of unique words. Words which cannot be packed go to a hash set.
+    // Readers do not sort: compact() the set once before it is read, then any number of threads can read it.
+    class SortedWords {
+      public:
+        using Keys = std::vector< Key, util::ArenaAllocator< Key > >;
+        using Others = std::unordered_set< std::string, std::hash< std::string >, std::equal_to< std::string >,
+                                           util::ArenaAllocator< std::string > >;
+
+        void emplace( std::string_view word ) {
+            Key key;
+            if ( !pack( word, key ) ) {
+                others_.emplace( word );
+                return;
+            }
+            keys_.push_back( key );
+            if ( keys_.size() - sorted_ >= std::max( kMinRun, sorted_ ) )
+                compact();
+        }
+
+        // move all words of other to this set, other is left empty
+        void merge( SortedWords& other );
+
+        bool contains( std::string_view word ) const;
+        // position of word until set is changed (std::string_view::npos if missing): index of its packed key,
+        // words which cannot be packed follow by bucketPosition()
+        std::size_t position( std::string_view word ) const;
+        std::size_t positions() const { // bound of positions
+            assert( compacted() );
+            return keys_.size() + bucketPositions( others_ );
+        }
+        std::size_t size() const {
+            assert( compacted() );
+            return keys_.size() + others_.size();
+        }
+        bool empty() const { return keys_.empty() && others_.empty(); }
+        void reserve( std::size_t words ) { keys_.reserve( words ); }
+        void clear();
+
+        // packed words in sorted order (unpack() them) and words which cannot be packed in no order
+        Keys const& keys() const {
+            assert( compacted() );
+            return keys_;
+        }
+        Others const& others() const { return others_; }
+
+        // call f( std::string_view ) for packed words in sorted order (view valid only during the call), then for others
+        template< typename F >
+        void forEach( F&& f ) const {
+            char word[ kMaxPacked ];
+            for ( Key key : keys() )
+                f( std::string_view( word, unpack( key, word ) ) );
+            for ( auto const& other : others_ )
+                f( std::string_view( other ) );
+        }
+
+        // sort and remove duplicates of unsorted tail, needed before size(), contains(), position() and keys()
+        void compact();
+        bool compacted() const { return sorted_ == keys_.size(); }
+
+      private:
+        static constexpr std::size_t kMinRun = 1 << 20; // keys appended before first sort
+
+        Keys keys_;
+        Keys tmp_; // scratch space for sorting and merging, kept for next rounds
+        std::size_t sorted_ = 0;
+        Others others_;
+    };
+
+} // namespace uwc
+
+#endif
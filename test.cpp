@@ -1,12 +1,38 @@
 #include "catch2/matchers/catch_matchers_string.hpp"
+#include "bitmap.hpp"
+#include "counter.hpp"
+#include "dump.hpp"
+#include "flat.hpp"
+#include "hash.hpp"
+#include "input.hpp"
+#include "output.hpp"
+#include "server.hpp"
+#include "setops.hpp"
+#include "sketch.hpp"
+#include "sorted.hpp"
+#include "tokenizer.hpp"
 #include "util.hpp"
+#include <catch2/catch_template_test_macros.hpp>
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_all.hpp>
+#include <cstdint>
+#include <random>
+#include <set>
 #include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifdef UWC_HAVE_ZLIB
+#    include <zlib.h>
+#endif
+#ifdef UWC_HAVE_ZSTD
+#    include <zstd.h>
+#endif
 
 using RE = std::runtime_error;
 using Catch::Matchers::EndsWith;
 using Catch::Matchers::Message;
+using Catch::Matchers::StartsWith;
 
 namespace {
     const std::string digits = "0123456789";
@@ -119,36 +145,36 @@ std::string_view skipFirst( std::string_view in ) {
     in.remove_prefix( 1 );
     return in;
 }
-TEST_CASE( "splitToChunks", "[util]" ) {
-    auto chunks = util::splitToChunks( "", 4 );
+TEST_CASE( "splitToChunks", "[tokenizer]" ) {
+    auto chunks = util::splitToChunks< util::SpaceDelimiters >( "", 4 );
     REQUIRE( chunks.size() == 1 );
     CHECK( chunks[ 0 ] == "" );
 
-    chunks = util::splitToChunks( "abcd", 5 );
+    chunks = util::splitToChunks< util::SpaceDelimiters >( "abcd", 5 );
     REQUIRE( chunks.size() == 1 );
     CHECK( chunks[ 0 ] == "abcd" );
 
-    chunks = util::splitToChunks( "abcdefgh", 5 );
+    chunks = util::splitToChunks< util::SpaceDelimiters >( "abcdefgh", 5 );
     REQUIRE( chunks.size() == 1 );
     CHECK( chunks[ 0 ] == "abcdefgh" );
 
-    chunks = util::splitToChunks( "abc def gh", 5 );
+    chunks = util::splitToChunks< util::SpaceDelimiters >( "abc def gh", 5 );
     REQUIRE( chunks.size() == 1 );
     CHECK( chunks[ 0 ] == "abc def gh" );
 
-    chunks = util::splitToChunks( "abc def gh", 3 );
+    chunks = util::splitToChunks< util::SpaceDelimiters >( "abc def gh", 3 );
     REQUIRE( chunks.size() == 3 );
     CHECK( chunks[ 0 ] == "abc " );
     CHECK( chunks[ 1 ] == "def " );
     CHECK( chunks[ 2 ] == "gh" );
 
-    chunks = util::splitToChunks( "a b c defgh", 3 );
+    chunks = util::splitToChunks< util::SpaceDelimiters >( "a b c defgh", 3 );
     REQUIRE( chunks.size() == 3 );
     CHECK( chunks[ 0 ] == "a b " );
     CHECK( chunks[ 1 ] == "c " );
     CHECK( chunks[ 2 ] == "defgh" );
 
-    chunks = util::splitToChunks( "a b c d            ef               gh", 3 );
+    chunks = util::splitToChunks< util::SpaceDelimiters >( "a b c d            ef               gh", 3 );
     CHECK( chunks.size() == 3 );
     CHECK( chunks[ 0 ] == "a b c d       " );
     CHECK( chunks[ 1 ] == "     ef       " );
@@ -160,10 +186,1140 @@ w gore slonce zatralala,
 zaba tylek z stawie moczy,
 kurcze co za dzien uroczy.)" );
 
-    auto res = util::splitToChunks( v, 4, '\n' );
+    auto res = util::splitToChunks< util::Delimiters< '\n' > >( v, 4 );
     REQUIRE( res.size() == 4 );
     CHECK( res[ 0 ] == "ptaszek sobie leci z dala,\n" );
     CHECK( res[ 1 ] == "w gore slonce zatralala,\n" );
     CHECK( res[ 2 ] == "zaba tylek z stawie moczy,\n" );
     CHECK( res[ 3 ] == "kurcze co za dzien uroczy." );
 }
+
+TEST_CASE( "delimiters", "[tokenizer]" ) {
+    CHECK( util::SpaceDelimiters::is( ' ' ) );
+    CHECK_FALSE( util::SpaceDelimiters::is( '\t' ) );
+    for ( char c : std::string( " \t\n\r\v\f" ) )
+        CHECK( util::WhitespaceDelimiters::is( c ) );
+    CHECK_FALSE( util::WhitespaceDelimiters::is( 'a' ) );
+    CHECK_FALSE( util::WhitespaceDelimiters::is( '\0' ) );
+    CHECK_FALSE( util::WhitespaceDelimiters::is( '\xa0' ) );
+    static_assert( util::Delimiters< ',', ';' >::is( ';' ) );
+
+    std::string_view text = "ab\tc d\n";
+    CHECK( util::findFirstDelimiter< util::WhitespaceDelimiters >( text ) == 2 );
+    CHECK( util::findFirstDelimiter< util::SpaceDelimiters >( text ) == 4 );
+    CHECK( util::findLastDelimiter< util::WhitespaceDelimiters >( text ) == 6 );
+    CHECK( util::findLastDelimiter< util::WhitespaceDelimiters >( text, 3 ) == 2 );
+    CHECK( util::findLastDelimiter< util::SpaceDelimiters >( text, 3 ) == util::npos );
+}
+
+TEST_CASE( "forEachWord", "[tokenizer]" ) {
+    std::vector< std::string_view > words;
+    auto collect = [ & ]( std::string_view w ) { words.push_back( w ); };
+    util::forEachWord< util::WhitespaceDelimiters >( "\n a\tbc  d\r\n", collect );
+    CHECK( words == std::vector< std::string_view >{ "a", "bc", "d" } );
+    words.clear();
+    util::forEachWord< util::SpaceDelimiters >( "a\tbc  d", collect );
+    CHECK( words == std::vector< std::string_view >{ "a\tbc", "d" } );
+    words.clear();
+    util::forEachWord< util::SpaceDelimiters >( "   ", collect );
+    CHECK( words.empty() );
+
+    // lines without spaces are still split between chunks
+    auto chunks = util::splitToChunks< util::WhitespaceDelimiters >( "abc\ndef\ngh", 3 );
+    REQUIRE( chunks.size() == 3 );
+    CHECK( chunks[ 0 ] == "abc\n" );
+    CHECK( chunks[ 1 ] == "def\n" );
+    CHECK( chunks[ 2 ] == "gh" );
+    chunks = util::splitToChunks< util::SpaceDelimiters >( "abc\ndef\ngh", 3 );
+    CHECK( chunks.size() == 1 );
+}
+
+TEST_CASE( "allocLarge", "[mem]" ) {
+    for ( bool huge : { false, true } ) {
+        util::enableHugePages( huge );
+        for ( std::size_t size : { std::size_t( 1 ), 5 * util::kKB, 3 * util::kMB } ) {
+            auto p = static_cast< char* >( util::allocLarge( size ) );
+            REQUIRE( p != nullptr );
+            std::memset( p, 'x', size );
+            CHECK( p[ size - 1 ] == 'x' );
+            util::freeLarge( p, size );
+        }
+    }
+    util::enableHugePages( false );
+}
+
+TEST_CASE( "arena", "[mem]" ) {
+    util::enableHugePages( true );
+    std::vector< std::pair< char*, std::size_t > > blocks;
+    for ( std::size_t size : { 1, 16, 17, 100, 256, 257, 4000, 2 * 1024 * 1024 } ) {
+        auto p = static_cast< char* >( util::Arena::allocate( size ) );
+        REQUIRE( p != nullptr );
+        CHECK( reinterpret_cast< std::uintptr_t >( p ) % 16 == 0 );
+        std::memset( p, static_cast< int >( size ), size );
+        blocks.emplace_back( p, size );
+    }
+    for ( auto [ p, size ] : blocks )
+        CHECK( static_cast< unsigned char >( p[ size - 1 ] ) == static_cast< unsigned char >( size ) );
+    CHECK( util::Arena::owns( blocks[ 6 ].first, 4000 ) ); // medium blocks (bucket arrays) come from chunks too
+    // freed small block is reused by the same size class
+    auto p = blocks[ 2 ].first;
+    util::Arena::deallocate( p, 17 );
+    CHECK( util::Arena::allocate( 32 ) == p );
+    for ( std::size_t i = 0; i < blocks.size(); ++i )
+        if ( i != 2 )
+            util::Arena::deallocate( blocks[ i ].first, blocks[ i ].second );
+    // blocks freed by exited thread are reused by other threads
+    void* freed = nullptr;
+    std::thread( [ & ] {
+        freed = util::Arena::allocate( 3000 );
+        util::Arena::deallocate( freed, 3000 );
+    } ).join();
+    void* reused = nullptr;
+    std::thread( [ & ] { reused = util::Arena::allocate( 4096 ); } ).join();
+    CHECK( reused == freed );
+    util::Arena::deallocate( reused, 4096 );
+    util::enableHugePages( false );
+}
+
+TEST_CASE( "arena-allocator", "[mem]" ) {
+    // blocks go back to the allocator they came from when huge pages are toggled in between
+    for ( bool huge : { true, false } ) {
+        util::enableHugePages( huge );
+        std::vector< int, util::ArenaAllocator< int > > small( 10, 1 ), large( util::kMB, 2 );
+        std::basic_string< char, std::char_traits< char >, util::ArenaAllocator< char > > word( 40, 'x' );
+        util::enableHugePages( !huge );
+        CHECK( util::Arena::owns( small.data(), small.size() * sizeof( int ) ) == huge );
+        CHECK( util::Arena::owns( large.data(), large.size() * sizeof( int ) ) == huge );
+        CHECK( util::Arena::owns( word.data(), word.capacity() + 1 ) == huge );
+        word.append( 100, 'y' ); // reallocated in the other mode
+        CHECK( word.size() == 140 );
+    }
+    util::enableHugePages( false );
+}
+
+TEST_CASE( "huge-page-stats", "[mem]" ) {
+    util::enableHugePages( true );
+    auto before = util::hugePageStats();
+    std::size_t size = 3 * util::kMB;
+    auto p = util::allocLarge( size );
+    auto after = util::hugePageStats();
+    // explicit huge pages are rarely reserved, then the mapping is advised for transparent ones (if kernel has them)
+    if ( after.hugetlbPages == before.hugetlbPages
+         && std::filesystem::exists( "/sys/kernel/mm/transparent_hugepage/enabled" ) )
+        CHECK( after.adviseBytes == before.adviseBytes + 2 * util::kHugePage );
+    else
+        CHECK( after.hugetlbPages == before.hugetlbPages + 2 );
+    CHECK_THAT( util::toString( after ), EndsWith( "advised)" ) );
+    util::freeLarge( p, size );
+    util::enableHugePages( false );
+}
+
+namespace {
+    std::filesystem::path tempFile( std::string const& name ) { return std::filesystem::temp_directory_path() / name; }
+
+    std::string sampleText() {
+        std::string text;
+        for ( int i = 0; i < 20000; ++i )
+            text += lettersL.substr( i % 26, 1 + i % 7 ) + ( i % 5 ? " " : "\n" );
+        return text;
+    }
+
+    std::string readFile( std::filesystem::path const& path ) {
+        std::ifstream in( path, std::ios::binary );
+        return { std::istreambuf_iterator< char >( in ), std::istreambuf_iterator< char >() };
+    }
+
+    // read whole input in pieces of given size
+    std::string readAll( util::Input& input, std::size_t piece ) {
+        std::string res, buf( piece, 0 );
+        while ( !input.eof() ) {
+            auto n = input.read( buf.data(), piece );
+            res.append( buf.data(), n );
+            if ( n < piece )
+                CHECK( input.eof() );
+        }
+        return res;
+    }
+} // namespace
+
+TEST_CASE( "input-plain", "[input]" ) {
+    auto path = tempFile( "uwc-input-plain.txt" );
+    auto text = sampleText();
+    std::ofstream( path, std::ios::binary ) << text;
+    CHECK( util::detectCompression( path ) == util::Compression::None );
+    auto input = util::openInput( path, 2 );
+    CHECK( readAll( *input, 1000 ) == text );
+    std::filesystem::remove( path );
+
+    CHECK_THROWS_AS( util::openInput( tempFile( "uwc-input-missing.txt" ), 1 ), RE );
+}
+
+#ifdef UWC_HAVE_ZLIB
+TEST_CASE( "input-gzip", "[input]" ) {
+    auto path = tempFile( "uwc-input.gz" );
+    auto text = sampleText();
+    { // two members
+        auto half = text.size() / 2;
+        for ( auto [ mode, part ] : { std::pair{ "wb", std::string_view( text ).substr( 0, half ) },
+                                      std::pair{ "ab", std::string_view( text ).substr( half ) } } ) {
+            gzFile f = gzopen( path.c_str(), mode );
+            REQUIRE( f );
+            gzwrite( f, part.data(), part.size() );
+            gzclose( f );
+        }
+    }
+    CHECK( util::detectCompression( path ) == util::Compression::Gzip );
+    auto input = util::openInput( path, 2 );
+    CHECK_THAT( input->describe(), EndsWith( "single thread" ) );
+    CHECK( readAll( *input, 777 ) == text );
+    std::filesystem::remove( path );
+}
+
+TEST_CASE( "input-bgzf", "[input]" ) {
+    auto path = tempFile( "uwc-input.bgz" );
+    auto text = sampleText();
+    {
+        std::ofstream out( path, std::ios::binary );
+        for ( std::size_t pos = 0; pos < text.size(); pos += 10000 ) {
+            auto part = std::string_view( text ).substr( pos, 10000 );
+            std::string body( compressBound( part.size() ), 0 );
+            z_stream zs{};
+            REQUIRE( deflateInit2( &zs, 6, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY ) == Z_OK );
+            zs.next_in = reinterpret_cast< Bytef* >( const_cast< char* >( part.data() ) );
+            zs.avail_in = part.size();
+            zs.next_out = reinterpret_cast< Bytef* >( body.data() );
+            zs.avail_out = body.size();
+            REQUIRE( deflate( &zs, Z_FINISH ) == Z_STREAM_END );
+            body.resize( zs.total_out );
+            deflateEnd( &zs );
+            auto le = []( std::string& s, std::uint32_t v, int bytes ) {
+                for ( int i = 0; i < bytes; ++i )
+                    s.push_back( static_cast< char >( ( v >> ( 8 * i ) ) & 0xff ) );
+            };
+            std::string block = "\x1f\x8b\x08\x04";
+            le( block, 0, 4 );  // mtime
+            block += std::string( "\x00\xff", 2 ); // xfl, os
+            le( block, 6, 2 );  // xlen
+            block += "BC";
+            le( block, 2, 2 );
+            le( block, static_cast< std::uint32_t >( 18 + body.size() + 8 - 1 ), 2 );
+            block += body;
+            le( block, crc32( 0, reinterpret_cast< Bytef const* >( part.data() ), part.size() ), 4 );
+            le( block, static_cast< std::uint32_t >( part.size() ), 4 );
+            out << block;
+        }
+    }
+    auto input = util::openInput( path, 3 );
+    CHECK_THAT( input->describe(), StartsWith( "gzip, 10 frames" ) );
+    CHECK( readAll( *input, 12345 ) == text );
+    std::filesystem::remove( path );
+}
+#endif
+
+#ifdef UWC_HAVE_ZSTD
+namespace {
+    // single frame of text, with decompressed size in header unless streamed (as by zstd reading a pipe)
+    std::string zstdFrame( std::string_view text, bool streamed = false ) {
+        std::string out( ZSTD_compressBound( text.size() ), 0 );
+        if ( !streamed ) {
+            auto n = ZSTD_compress( out.data(), out.size(), text.data(), text.size(), 1 );
+            REQUIRE_FALSE( ZSTD_isError( n ) );
+            out.resize( n );
+            return out;
+        }
+        auto cctx = ZSTD_createCCtx();
+        ZSTD_CCtx_setParameter( cctx, ZSTD_c_contentSizeFlag, 0 );
+        ZSTD_outBuffer dst{ out.data(), out.size(), 0 };
+        ZSTD_inBuffer src{ text.data(), text.size(), 0 };
+        auto left = ZSTD_compressStream2( cctx, &dst, &src, ZSTD_e_end );
+        ZSTD_freeCCtx( cctx );
+        REQUIRE( left == 0 );
+        out.resize( dst.pos );
+        return out;
+    }
+} // namespace
+
+TEST_CASE( "input-zstd", "[input]" ) {
+    auto path = tempFile( "uwc-input.zst" );
+    auto text = sampleText();
+    SECTION( "frames decoded in parallel" ) {
+        {
+            std::ofstream out( path, std::ios::binary );
+            for ( std::size_t pos = 0; pos < text.size(); pos += 10000 )
+                out << zstdFrame( std::string_view( text ).substr( pos, 10000 ) );
+        }
+        CHECK( util::detectCompression( path ) == util::Compression::Zstd );
+        auto input = util::openInput( path, 3 );
+        CHECK_THAT( input->describe(), StartsWith( "zstd, 10 frames" ) );
+        CHECK( readAll( *input, 12345 ) == text );
+    }
+    SECTION( "frames without size streamed" ) {
+        {
+            std::ofstream out( path, std::ios::binary );
+            auto half = text.size() / 2;
+            out << zstdFrame( std::string_view( text ).substr( 0, half ), true )
+                << zstdFrame( std::string_view( text ).substr( half ), true );
+        }
+        auto input = util::openInput( path, 3 );
+        CHECK_THAT( input->describe(), EndsWith( "single thread" ) );
+        CHECK( readAll( *input, 777 ) == text );
+    }
+    SECTION( "frame too big for parallel decoding streamed" ) {
+        std::string big;
+        while ( big.size() <= 40 * util::kMB )
+            big += text;
+        {
+            std::ofstream out( path, std::ios::binary );
+            out << zstdFrame( text ) << zstdFrame( big );
+        }
+        auto input = util::openInput( path, 3 );
+        CHECK_THAT( input->describe(), EndsWith( "single thread" ) );
+        CHECK( readAll( *input, util::kMB ) == text + big );
+    }
+    SECTION( "corrupted" ) {
+        auto frame = zstdFrame( text );
+        std::ofstream( path, std::ios::binary ) << frame << frame.substr( 0, frame.size() / 2 );
+        CHECK_THROWS_AS( readAll( *util::openInput( path, 3 ), 1000 ), std::runtime_error );
+    }
+    SECTION( "truncated streamed" ) {
+        auto frame = zstdFrame( text, true );
+        std::ofstream( path, std::ios::binary ) << frame << frame.substr( 0, frame.size() / 2 );
+        auto input = util::openInput( path, 3 ); // frame without size is not indexed further
+        CHECK_THAT( input->describe(), EndsWith( "single thread" ) );
+        CHECK_THROWS_WITH( readAll( *input, 1000 ), "Truncated zstd stream" );
+    }
+    std::filesystem::remove( path );
+}
+#endif
+
+TEMPLATE_TEST_CASE(
+    "counter-feed", "[counter]", uwc::agg::Single, uwc::agg::Multi, uwc::agg::DelayedSingle, uwc::agg::DelayedMulti ) {
+    uwc::Counter< uwc::HashEngine, TestType > counter( 3 );
+    std::string_view text = "a horse and a dog\nand a cat  ";
+    SECTION( "whole" ) {
+        counter.feed( text );
+        CHECK( counter.count() == 5 );
+    }
+    SECTION( "byte by byte" ) {
+        for ( std::size_t i = 0; i < text.size(); ++i )
+            counter.feed( text.substr( i, 1 ) );
+        CHECK( counter.count() == 5 );
+    }
+    SECTION( "word split between pieces" ) {
+        counter.feed( "a hor" );
+        counter.feed( "se" );
+        counter.feed( "s horse" );
+        CHECK( counter.count() == 3 ); // a, horses, horse (pending word completed by count())
+        CHECK( counter.words().contains( uwc::lookupKey< uwc::Words >( "horses" ) ) );
+        counter.feed( " zebra" );
+        CHECK( counter.count() == 4 );
+    }
+    SECTION( "reset" ) {
+        counter.feed( text );
+        CHECK( counter.count() == 5 );
+        counter.reset();
+        CHECK( counter.count() == 0 );
+        counter.feed( "x y x" );
+        CHECK( counter.count() == 2 );
+    }
+}
+
+TEST_CASE( "wordStats", "[tokenizer]" ) {
+    // random words crossing 64 byte blocks, compared with plain scan
+    std::mt19937 rnd( 3 );
+    for ( std::size_t size : { 1, 63, 64, 65, 128, 1000, 5000 } ) {
+        std::string text;
+        while ( text.size() < size ) {
+            auto c = rnd() % 8;
+            text.push_back( c == 0 ? ' ' : c == 1 ? '\n' : static_cast< char >( 'a' + rnd() % 26 ) );
+            if ( rnd() % 50 == 0 ) // long words
+                text.append( rnd() % 100, 'x' );
+        }
+        text.resize( size );
+
+        util::WordStats expected;
+        std::vector< std::string_view > expectedWords;
+        std::size_t start = 0;
+        for ( std::size_t i = 0; i <= text.size(); ++i )
+            if ( i == text.size() || text[ i ] == ' ' || text[ i ] == '\n' ) {
+                if ( i > start ) {
+                    ++expected.total;
+                    expected.add( i - start );
+                    expectedWords.emplace_back( text.data() + start, i - start );
+                }
+                start = i + 1;
+            }
+
+        util::WordStats stats;
+        std::vector< std::string_view > words;
+        util::forEachWord< util::WhitespaceDelimiters >( text, stats, [ & ]( std::string_view w ) { words.push_back( w ); } );
+        CHECK( words == expectedWords );
+        CHECK( stats.total == expected.total );
+        CHECK( stats.lengths == expected.lengths );
+    }
+}
+
+TEST_CASE( "hash", "[hash]" ) {
+    // same values with every compiler and standard library
+    CHECK( uwc::hash::Wy::hash( "horse" ) == 0xee8415fc688d869eull );
+    CHECK( uwc::hash::Wy::hash( "" ) == 0x409638ee2bde459ull );
+    CHECK( uwc::hash::Wy::hash( "abcdefghijklmnopqrstuvwxyz" ) == 0x774fa8c21ed6acd2ull );
+    CHECK( uwc::hash::crc32c( "123456789" ) == 0xe3069283 );
+    CHECK( uwc::hash::crc32cSoftware( "123456789" ) == 0xe3069283 );
+
+    std::mt19937 rnd( 5 );
+    std::string text;
+    for ( std::size_t i = 0; i < 1000; ++i )
+        text.push_back( static_cast< char >( rnd() ) );
+    for ( std::size_t len = 0; len < 40; ++len ) {
+        auto part = std::string_view( text ).substr( len, len );
+        CHECK( uwc::hash::crc32c( part ) == uwc::hash::crc32cSoftware( part ) );
+        CHECK( uwc::hash::crc32c64( part ) == uwc::hash::crc32c64Software( part ) );
+    }
+    CHECK( uwc::hash::Crc32c::hash( "horse" ) >> 32 != 0 ); // both lanes used
+    CHECK( uwc::hash::Crc32c::hash( "a" ) != uwc::hash::Crc32c::hash( std::string_view( "a\0", 2 ) ) );
+
+    CHECK( uwc::hash::Packed::hash( "a" ) == 1 );
+    CHECK( uwc::hash::Packed::hash( "ab" ) == ( 1 << 5 | 2 ) );
+    CHECK( uwc::hash::Packed::hash( "Ab" ) == uwc::hash::Wy::hash( "Ab" ) );
+    CHECK( uwc::hash::Packed::hash( "abcdefghijklm" ) == uwc::hash::Wy::hash( "abcdefghijklm" ) );
+
+    // words differing in one letter or length get different hashes
+    std::set< std::uint64_t > wy, crc, packed;
+    std::string word;
+    for ( char a = 'a'; a <= 'z'; ++a )
+        for ( char b = 'a'; b <= 'z'; ++b )
+            for ( std::size_t len = 1; len <= 20; ++len ) {
+                word.assign( len, a );
+                word.back() = b;
+                wy.insert( uwc::hash::Wy::hash( word ) );
+                crc.insert( uwc::hash::Crc32c::hash( word ) );
+                packed.insert( uwc::hash::Packed::hash( word ) );
+            }
+    std::size_t expected = 26 * 26 * 19 + 26; // words of length 1 depend on b only
+    CHECK( wy.size() == expected );
+    CHECK( crc.size() == expected );
+    CHECK( packed.size() == expected );
+}
+
+TEMPLATE_TEST_CASE( "hash-policies", "[hash]", uwc::hash::Std, uwc::hash::Wy, uwc::hash::Crc32c, uwc::hash::Packed ) {
+    std::string_view text = "a horse and a dog\nand a cat abcdefghijklmnopqrstuvwxyz ABC abcdefghijklmnopqrstuvwxyz";
+    uwc::Counter< uwc::BasicHashEngine< TestType >, uwc::agg::Multi > hash( 3 );
+    hash.feed( text );
+    CHECK( hash.count() == 7 );
+    uwc::Counter< uwc::BasicFlatEngine< TestType >, uwc::agg::DelayedMulti > flat( 3 );
+    flat.feed( text );
+    CHECK( flat.count() == 7 );
+    CHECK( flat.words().contains( "ABC" ) );
+}
+
+TEST_CASE( "flat-words", "[flat]" ) {
+    uwc::FlatSet< uwc::hash::Wy > words, other;
+    CHECK_FALSE( words.contains( "a" ) );
+    std::string longWord( 100, 'x' );
+    for ( std::string_view w : { "dog", "a", "horse", "a", "dog", "abcdefghijklmnopqrstuvwxyz", "abcdefghijklmnopqrstuvw" } )
+        words.emplace( w );
+    words.emplace( longWord );
+    CHECK( words.size() == 6 );
+    CHECK( words.contains( "abcdefghijklmnopqrstuvwxyz" ) );
+    CHECK( words.contains( "abcdefghijklmnopqrstuvw" ) );
+    CHECK( words.contains( longWord ) );
+    CHECK_FALSE( words.contains( "abcdefghijklmnopqrstuvwx" ) );
+    CHECK_FALSE( words.contains( "" ) );
+
+    // growing, long words keep storage
+    std::vector< std::string > many;
+    for ( std::size_t i = 0; i < 100'000; ++i )
+        many.push_back( std::to_string( i ) + ( i % 3 ? "" : longWord ) );
+    for ( auto const& w : many )
+        other.emplace( w, uwc::FlatSet< uwc::hash::Wy >::hash( w ) );
+    CHECK( other.size() == many.size() );
+    other.emplace( "cat" );
+    other.emplace( longWord );
+
+    words.merge( other );
+    CHECK( other.empty() );
+    CHECK_FALSE( other.contains( "cat" ) );
+    CHECK( words.size() == 6 + many.size() + 1 );
+    CHECK( std::all_of( many.begin(), many.end(), [ & ]( auto const& w ) { return words.contains( w ); } ) );
+    CHECK( words.contains( "cat" ) );
+    CHECK( words.contains( longWord ) );
+
+    words.clear();
+    CHECK( words.size() == 0 );
+    CHECK_FALSE( words.contains( "cat" ) );
+    words.emplace( longWord );
+    CHECK( words.contains( longWord ) );
+}
+
+TEST_CASE( "pack", "[sorted]" ) {
+    uwc::Key a, b;
+    char out[ uwc::kMaxPacked ];
+    for ( std::string_view w : { "a", "z", "horse", "abcdefghijklmnopqrstuvwxy" } ) {
+        REQUIRE( uwc::pack( w, a ) );
+        CHECK( std::string_view( out, uwc::unpack( a, out ) ) == w );
+    }
+    CHECK_FALSE( uwc::pack( "", a ) );
+    CHECK_FALSE( uwc::pack( "abcdefghijklmnopqrstuvwxyz", a ) ); // too long
+    CHECK_FALSE( uwc::pack( "Horse", a ) );
+    CHECK_FALSE( uwc::pack( "ho{se", a ) );
+    CHECK_FALSE( uwc::pack( "ho`se", a ) );
+
+    // keys compare like words
+    for ( auto [ x, y ] : { std::pair( "a", "b" ), { "a", "aa" }, { "ab", "b" }, { "horse", "horses" }, { "y", "yz" } } ) {
+        uwc::pack( x, a );
+        uwc::pack( y, b );
+        CHECK( a < b );
+    }
+}
+
+TEST_CASE( "radixSort", "[sorted]" ) {
+    std::mt19937_64 rnd( 7 );
+    for ( std::size_t n : { 0, 1, 2, 63, 64, 65, 1000, 100000 } ) {
+        std::vector< uwc::Key > keys( n ), tmp( n );
+        for ( auto& k : keys ) {
+            k = ( static_cast< uwc::Key >( rnd() ) << 64 ) | rnd();
+            if ( rnd() % 3 == 0 ) // common prefixes and duplicates
+                k &= ~static_cast< uwc::Key >( 0 ) << ( 8 * ( rnd() % 16 ) );
+        }
+        auto expected = keys;
+        std::sort( expected.begin(), expected.end() );
+        uwc::radixSort( keys.data(), tmp.data(), n );
+        CHECK( keys == expected );
+    }
+}
+
+TEST_CASE( "sorted-words", "[sorted]" ) {
+    uwc::SortedWords words, other;
+    for ( auto w : { "dog", "a", "horse", "a", "Dog", "dog", "abcdefghijklmnopqrstuvwxyz" } )
+        words.emplace( w );
+    CHECK_FALSE( words.compacted() );
+    words.compact(); // before the set is read
+    CHECK( words.compacted() );
+    CHECK( words.size() == 5 );
+    CHECK( words.contains( "horse" ) );
+    CHECK( words.contains( "Dog" ) );
+    CHECK_FALSE( words.contains( "cat" ) );
+    words.emplace( "cat" ); // unsorted tail after sorted prefix
+    words.compact();
+    CHECK( words.contains( "cat" ) );
+
+    for ( auto w : { "cat", "zebra", "Dog", "Cat" } )
+        other.emplace( w );
+    words.merge( other );
+    CHECK( other.empty() );
+    CHECK( words.size() == 8 );
+    CHECK( words.contains( "zebra" ) );
+    CHECK( words.contains( "Cat" ) );
+
+    // many rounds of sorting
+    std::string w;
+    for ( std::size_t i = 0; i < 3'000'000; ++i ) {
+        w.clear();
+        for ( std::size_t n = i % 200'000 + 1; n > 0; n /= 26 )
+            w.push_back( static_cast< char >( 'a' + n % 26 ) );
+        words.emplace( w );
+    }
+    words.compact();
+    CHECK( words.size() == 8 + 200'000 - 2 ); // "cat" and "dog" are generated too
+    words.clear();
+    CHECK( words.size() == 0 );
+}
+
+TEST_CASE( "short-words", "[bitmap]" ) {
+    CHECK_THROWS_AS( uwc::ShortWords( 0 ), std::invalid_argument );
+    CHECK_THROWS_AS( uwc::ShortWords( uwc::ShortWords::kMaxLength + 1 ), std::invalid_argument );
+
+    uwc::ShortWords words( 3 );
+    CHECK( words.bytes() * 8 >= 26 + 26 * 26 + 26 * 26 * 26 );
+    for ( auto word : { "a", "z", "zz", "aaa", "zzz", "a", "zzz" } )
+        CHECK( words.insert( word ) );
+    for ( auto word : { "", "aaaa", "ABC", "a b", "b1", "\xe1" } )
+        CHECK_FALSE( words.insert( word ) );
+    CHECK( words.count() == 5 );
+    CHECK( words.contains( "zz" ) );
+    CHECK_FALSE( words.contains( "aa" ) );
+    CHECK_FALSE( words.contains( "aaaa" ) );
+    words.clear();
+    CHECK( words.count() == 0 );
+    CHECK_FALSE( words.contains( "zzz" ) );
+
+    uwc::ShortWords all( uwc::ShortWords::kMaxLength );
+    CHECK( all.insert( "zzzzzz" ) );
+    CHECK( all.insert( "a" ) );
+    CHECK( all.count() == 2 );
+}
+
+TEST_CASE( "counter-short-words", "[counter]" ) {
+    auto text = sampleText() + " Horse x" + lettersL;
+    uwc::Counter<> reference( 1 );
+    reference.feed( text );
+    auto expected = reference.count();
+
+    auto check = [ & ]( auto& counter ) {
+        counter.useShortWords( 5 );
+        // odd pieces split words between feeds
+        for ( std::size_t pos = 0; pos < text.size(); pos += 7 )
+            counter.feed( std::string_view( text ).substr( pos, 7 ) );
+        CHECK( counter.count() == expected );
+        CHECK( counter.shortWords()->count() > 0 );
+        counter.reset();
+        CHECK( counter.count() == 0 );
+        counter.useShortWords( 0 );
+        CHECK( counter.shortWords() == nullptr );
+    };
+    uwc::Counter< uwc::HashEngine, uwc::agg::Single > hash( 3 );
+    check( hash );
+    uwc::Counter< uwc::FlatEngine, uwc::agg::DelayedMulti > flat( 3 );
+    check( flat );
+    uwc::Counter< uwc::SortEngine, uwc::agg::Multi > sorted( 3 );
+    check( sorted );
+}
+
+TEST_CASE( "counter-stats", "[counter]" ) {
+    uwc::Counter< uwc::SortEngine, uwc::agg::Single > counter( 3 );
+    counter.feed( "a horse and a do" );
+    counter.feed( "g\nand a cat " );
+    counter.feed( "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz" );
+    CHECK( counter.count() == 6 );
+    auto stats = counter.stats();
+    CHECK( stats.total == 9 );
+    CHECK( stats.lengths[ 1 ] == 3 );
+    CHECK( stats.lengths[ 3 ] == 4 );
+    CHECK( stats.lengths[ 5 ] == 1 );
+    CHECK( stats.lengths[ util::WordStats::kMaxStatsLength ] == 1 );
+    counter.reset();
+    CHECK( counter.stats().total == 0 );
+}
+
+TEST_CASE( "counter-delimiters", "[counter]" ) {
+    std::string_view text = "a\tb a\nb\r\nc";
+    uwc::Counter< uwc::HashEngine, uwc::agg::Multi > whitespace( 3 );
+    whitespace.feed( text );
+    CHECK( whitespace.count() == 3 );
+    uwc::Counter< uwc::HashEngine, uwc::agg::Multi, util::SpaceDelimiters > space( 3 );
+    space.feed( text );
+    CHECK( space.count() == 2 ); // "a\tb", "a\nb\r\nc"
+}
+
+TEST_CASE( "counter-file", "[counter]" ) {
+    auto path = tempFile( "uwc-counter.txt" );
+    auto text = sampleText();
+    std::ofstream( path, std::ios::binary ) << text;
+
+    uwc::Counter<> reference( 1 );
+    reference.feed( text );
+    auto expected = reference.count();
+    CHECK( expected == 26 * 7 - 21 ); // substrings of letters of length 1..7 without those running past 'z'
+
+    uwc::Counter< uwc::HashEngine, uwc::agg::Multi > counter( 4, 1000 );
+    counter.feedFile( path );
+    CHECK( counter.count() == expected );
+
+    uwc::Counter< uwc::FlatEngine, uwc::agg::DelayedMulti > flat( 4, 1000 );
+    flat.feedFile( path );
+    CHECK( flat.count() == expected );
+
+    uwc::Counter< uwc::SortEngine, uwc::agg::DelayedMulti > sorted( 4, 1000 );
+    sorted.feedFile( path );
+    CHECK( sorted.count() == expected );
+    std::filesystem::remove( path );
+}
+
+TEST_CASE( "counter-ranges", "[counter]" ) {
+    auto path = tempFile( "uwc-ranges.txt" );
+    // long words and runs of spaces cross range and block ends, no delimiter at the end
+    auto text = "  " + sampleText() + std::string( 3000, 'x' ) + "   " + std::string( 5000, 'y' ) + " " + sampleText() + "end";
+    std::ofstream( path, std::ios::binary ) << text;
+
+    uwc::Counter<> reference( 1 );
+    reference.feed( text );
+    auto expected = reference.count();
+    auto total = reference.stats().total;
+
+    auto check = [ & ]( auto& counter ) {
+        counter.feed( "pending" );
+        counter.feedFileRanges( path );
+        CHECK( counter.count() == expected + 1 ); // "pending" is complete before the file
+        CHECK( counter.stats().total == total + 1 );
+        counter.reset();
+        counter.feedFileRanges( path );
+        counter.feedFileRanges( path );
+        CHECK( counter.count() == expected );
+        CHECK( counter.stats().total == 2 * total );
+        counter.reset();
+    };
+    for ( unsigned threads : { 1, 3, 7 } ) {
+        uwc::Counter< uwc::HashEngine, uwc::agg::Single > hash( threads, 1000 );
+        check( hash );
+        uwc::Counter< uwc::FlatEngine, uwc::agg::DelayedMulti > flat( threads, 4 ); // buffers grow for long words
+        check( flat );
+        uwc::Counter< uwc::SortEngine, uwc::agg::Multi > sorted( threads, 1 * util::kMB );
+        check( sorted );
+    }
+
+    uwc::Counter<> counter( 2 );
+    counter.useSegments( 1000 );
+    CHECK_THROWS_AS( counter.feedFileRanges( path ), std::logic_error );
+    counter.useSegments( 0 );
+    CHECK_THROWS_AS( counter.feedFileRanges( tempFile( "uwc-ranges-missing.txt" ) ), std::runtime_error );
+    std::filesystem::remove( path );
+}
+
+TEST_CASE( "output", "[output]" ) {
+    auto path = tempFile( "uwc-output.txt" );
+    {
+        util::Output out( path, 8 );
+        out.writeLine( "abc" );
+        out.write( "0123456789" ); // longer than buffer
+        out.writeLine( "defgh" );
+        CHECK( out.written() == 20 );
+        out.close();
+    }
+    CHECK( readFile( path ) == "abc\n0123456789defgh\n" );
+    std::filesystem::remove( path );
+    CHECK_THROWS_AS( util::Output( tempFile( "uwc-missing-dir" ) / "out.txt" ), RE );
+}
+
+TEST_CASE( "dump", "[dump]" ) {
+    auto path = tempFile( "uwc-dump.txt" );
+    auto text = sampleText() + " Horse A-Z " + lettersL + lettersL + " \xc3\xa1";
+    std::set< std::string > expected;
+    util::forEachWord< util::WhitespaceDelimiters >( text, [ & ]( std::string_view word ) { expected.emplace( word ); } );
+    std::string sorted;
+    for ( auto const& word : expected )
+        sorted += word + "\n";
+
+    auto check = [ & ]( auto& counter, unsigned shortWords ) {
+        counter.useShortWords( shortWords );
+        counter.feed( text );
+        CHECK( uwc::dumpWords( counter, path, false ) == expected.size() );
+        auto dumped = readFile( path );
+        std::multiset< std::string > words;
+        util::forEachWord< util::WhitespaceDelimiters >( dumped, [ & ]( std::string_view word ) { words.emplace( word ); } );
+        CHECK( std::equal( words.begin(), words.end(), expected.begin(), expected.end() ) );
+
+        CHECK( uwc::dumpWords( counter, path, true ) == expected.size() );
+        CHECK( readFile( path ) == sorted );
+        counter.reset();
+    };
+    for ( unsigned shortWords : { 0, 3 } ) {
+        uwc::Counter< uwc::HashEngine, uwc::agg::Single > hash( 3 );
+        check( hash, shortWords );
+        uwc::Counter< uwc::FlatEngine, uwc::agg::DelayedMulti > flat( 3 );
+        check( flat, shortWords );
+        uwc::Counter< uwc::SortEngine, uwc::agg::Multi > sort( 3 );
+        check( sort, shortWords );
+    }
+
+    // partitions sorted by threads merged with a run
+    expected.clear();
+    uwc::WordDump dump( path, true, 4 );
+    for ( int i = 0; i < 300000; ++i ) {
+        auto word = std::to_string( std::uint64_t( i ) * 7919 % 300007 );
+        expected.emplace( word );
+        dump.addTemporary( word );
+    }
+    dump.beginRun();
+    for ( auto word : { "a", "b", "c" } ) {
+        expected.emplace( word );
+        dump.add( word );
+    }
+    dump.endRun();
+    CHECK( dump.finish() == expected.size() );
+    sorted.clear();
+    for ( auto const& word : expected )
+        sorted += word + "\n";
+    CHECK( readFile( path ) == sorted );
+    std::filesystem::remove( path );
+}
+
+TEST_CASE( "sketch", "[sketch]" ) {
+    CHECK_THROWS_AS( uwc::Sketch( uwc::Sketch::kMinPrecision - 1 ), std::invalid_argument );
+    CHECK_THROWS_AS( uwc::Sketch( uwc::Sketch::kMaxPrecision + 1 ), std::invalid_argument );
+
+    uwc::Sketch a, b;
+    CHECK( a.estimate() == 0 );
+    for ( int i = 0; i < 200000; ++i ) {
+        a.add( "w" + std::to_string( i ) );
+        a.add( "w" + std::to_string( i ) );
+        b.add( "w" + std::to_string( i + 100000 ) );
+    }
+    CHECK( std::abs( a.estimate() - 200000 ) < 200000 * 0.03 );
+    a.merge( b );
+    CHECK( std::abs( a.estimate() - 300000 ) < 300000 * 0.03 );
+    uwc::Sketch small;
+    for ( auto word : { "a", "horse", "and", "a", "dog" } )
+        small.add( word );
+    CHECK( std::abs( small.estimate() - 4 ) < 0.1 ); // linear counting
+    CHECK_THROWS_AS( a.merge( uwc::Sketch( 10 ) ), std::invalid_argument );
+
+    auto path = tempFile( "uwc-sketch.hll" );
+    a.save( path );
+    CHECK( uwc::Sketch::load( path ).estimate() == a.estimate() );
+    std::ofstream( path, std::ios::binary ) << "uwc-hll1\x0e";
+    CHECK_THROWS_WITH( uwc::Sketch::load( path ), StartsWith( "Corrupted sketch file" ) );
+    std::ofstream( path, std::ios::binary ) << "a horse";
+    CHECK_THROWS_WITH( uwc::Sketch::load( path ), StartsWith( "Not a sketch file" ) );
+    std::filesystem::remove( path );
+}
+
+TEST_CASE( "set-positions", "[counter]" ) {
+    auto check = [ & ]( auto& set, auto position, auto positions ) {
+        std::vector< std::string > words;
+        for ( int i = 0; i < 5000; ++i ) { // packable letters of i and words with other characters
+            std::string word = i % 2 ? "" : "w-" + std::to_string( i );
+            for ( int n = i; i % 2 && n > 0; n /= 26 )
+                word += lettersL[ n % 26 ];
+            words.push_back( word );
+        }
+        for ( auto const& word : words )
+            set.emplace( word );
+        if constexpr ( requires { set.compact(); } )
+            set.compact();
+        std::set< std::size_t > seen;
+        for ( auto const& word : words ) {
+            auto pos = position( word );
+            CHECK( pos < positions() );
+            seen.insert( pos );
+        }
+        CHECK( seen.size() == words.size() ); // dense index
+        CHECK( position( "missing" ) == uwc::npos );
+    };
+    uwc::FlatSet< uwc::hash::Wy > flat;
+    check( flat, [ & ]( std::string_view w ) { return flat.position( w ); }, [ & ] { return flat.positions(); } );
+    uwc::SortedWords sorted;
+    check( sorted, [ & ]( std::string_view w ) { return sorted.position( w ); }, [ & ] { return sorted.positions(); } );
+    uwc::Words words;
+    check( words, [ & ]( std::string_view w ) { return uwc::bucketPosition( words, w ); },
+           [ & ] { return uwc::bucketPositions( words ); } );
+}
+
+TEST_CASE( "counter-reference", "[counter]" ) {
+    auto check = [ & ]( auto& reference, auto& probe ) {
+        reference.useShortWords( 3 );
+        reference.feed( "a horse and a dog and elephants " );
+        reference.count();
+        probe.useShortWords( 3 );
+        probe.useReference( reference.reference() );
+        for ( auto piece : { "a cat and a ", "dog ", "and a hor", "se and ", "another horse", " giraffe" } )
+            probe.feed( piece );
+        CHECK( probe.count() == 4 ); // a, and, dog, horse
+        CHECK( std::abs( probe.sketch().estimate() - 3 ) < 0.1 ); // cat, another, giraffe
+        CHECK( probe.stats().total == 12 );
+        CHECK( reference.count() == 5 ); // unchanged
+        probe.reset();
+        probe.feed( "dog elephants" );
+        CHECK( probe.count() == 2 ); // marks were cleared
+
+        probe.useReference( std::nullopt );
+        probe.feed( "cat horse" );
+        CHECK( probe.count() == 2 );
+        CHECK_THROWS_AS( probe.sketch(), std::logic_error );
+    };
+    uwc::Counter< uwc::HashEngine, uwc::agg::Single > hash( 3 ), hashProbe( 3 );
+    check( hash, hashProbe );
+    uwc::Counter< uwc::FlatEngine, uwc::agg::DelayedMulti > flat( 3 ), flatProbe( 3 );
+    check( flat, flatProbe );
+    uwc::Counter< uwc::SortEngine, uwc::agg::Multi > sort( 3 ), sortProbe( 3 );
+    check( sort, sortProbe );
+}
+
+TEST_CASE( "counter-segments", "[counter]" ) {
+    auto path = tempFile( "uwc-segments.txt" );
+    std::ofstream( path, std::ios::binary ) << "aaa bbb ccc ddd aaa eee\nfff";
+    auto check = [ & ]( auto& counter ) {
+        CHECK_THROWS_AS( counter.endSegment(), std::logic_error );
+        counter.useShortWords( 3 );
+        counter.useSegments( 9 );
+        counter.feedFile( path ); // "aaa bbb c|cc ddd aa|a eee\nfff", word crossing the end belongs to next segment
+        CHECK( counter.count() == 6 );
+        auto const& segments = counter.segments();
+        REQUIRE( segments.size() == 3 );
+        std::vector< double > distinct{ 2, 2, 3 };
+        std::vector< double > cumulative{ 2, 4, 6 };
+        for ( std::size_t i = 0; i < segments.size(); ++i ) {
+            CHECK( segments[ i ].offset == 9 * i );
+            CHECK( segments[ i ].size == 9 );
+            CHECK( std::abs( segments[ i ].distinct - distinct[ i ] ) < 0.1 );
+            CHECK( std::abs( segments[ i ].cumulative - cumulative[ i ] ) < 0.1 );
+        }
+        counter.feed( "ggg " );
+        CHECK( std::abs( counter.endSegment().distinct - 1 ) < 0.1 );
+        counter.reset();
+        CHECK( counter.segments().empty() );
+    };
+    uwc::Counter< uwc::HashEngine, uwc::agg::Single > hash( 2, 4 );
+    check( hash );
+    uwc::Counter< uwc::FlatEngine, uwc::agg::DelayedMulti > flat( 2, 4 );
+    check( flat );
+    uwc::Counter< uwc::SortEngine, uwc::agg::Multi > sort( 2, 4 );
+    check( sort );
+    std::filesystem::remove( path );
+}
+
+TEST_CASE( "counter-perf", "[counter]" ) {
+    // hardware counters are often forbidden (containers, perf_event_paranoid), only times are checked
+    auto text = sampleText();
+    uwc::Counter< uwc::HashEngine, uwc::agg::Single > expected( 1, 16 );
+    expected.feed( text );
+    auto check = [ & ]( auto& counter ) {
+        counter.usePerf( true );
+        REQUIRE( counter.perfCounters() != nullptr );
+        for ( int i = 0; i < 3; ++i )
+            counter.feed( text );
+        CHECK( counter.count() == expected.count() );
+        auto counts = counter.perfCounts();
+        CHECK( counts[ uwc::TokenizePhase ].nanoseconds > 0 );
+        CHECK( counts[ uwc::InsertPhase ].nanoseconds > 0 );
+        for ( auto event : { util::Cycles, util::Instructions } )
+            if ( !counter.perfCounters()->available( event ) )
+                CHECK( counts[ uwc::InsertPhase ].events[ event ] == 0 );
+        counter.reset();
+        CHECK( counter.perfCounts()[ uwc::InsertPhase ].nanoseconds == 0 );
+        counter.usePerf( false );
+        CHECK( counter.perfCounters() == nullptr );
+    };
+    uwc::Counter< uwc::HashEngine, uwc::agg::Multi > hash( 2, 16 );
+    check( hash );
+    uwc::Counter< uwc::FlatEngine, uwc::agg::DelayedSingle > flat( 2, 16 );
+    check( flat );
+}
+
+TEST_CASE( "compare", "[setops]" ) {
+    auto small = tempFile( "uwc-compare-small.txt" );
+    auto big = tempFile( "uwc-compare-big.txt" );
+    auto index = tempFile( "uwc-compare-small.uwi" );
+    auto sketch = tempFile( "uwc-compare-big.hll" );
+    std::ofstream( small, std::ios::binary ) << "a horse and a dog\nbird";
+    std::ofstream( big, std::ios::binary ) << sampleText() << " horse dog\ncat";
+
+    uwc::Counter<> counter( 2 );
+    counter.feedFile( big );
+    auto bigCount = counter.count(); // with sample words a, b, ... "abc"
+    uwc::Sketch bigSketch;
+    counter.forEachWord( [ & ]( std::string_view word ) { bigSketch.add( word ); } );
+    bigSketch.save( sketch );
+    counter.reset();
+    counter.feedFile( small );
+    counter.count();
+    uwc::dumpWords( counter, index, true );
+    CHECK( readFile( index ) == "a\nand\nbird\ndog\nhorse\n" );
+
+    using Engine = uwc::FlatEngine;
+    using Agg = uwc::agg::DelayedSingle;
+    using Delims = util::WhitespaceDelimiters;
+    for ( auto const& first : { small, index } ) {
+        auto res = uwc::compare< Engine, Agg, Delims >( first, big, 0 );
+        CHECK( res.first == 5 );
+        CHECK( res.firstExact );
+        CHECK( res.common == 3 ); // a, horse, dog
+        CHECK( res.commonExact );
+        CHECK( res.onlyFirst() == 2 );
+        CHECK( res.onlyFirstExact() );
+        CHECK( std::abs( res.second - bigCount ) < bigCount * 0.03 );
+        CHECK_FALSE( res.secondExact );
+
+        auto swapped = uwc::compare< Engine, Agg, Delims >( big, first, 4 );
+        CHECK( swapped.second == 5 );
+        CHECK( swapped.common == 3 );
+        CHECK_FALSE( swapped.onlyFirstExact() );
+        CHECK( std::abs( swapped.jaccard() * ( bigCount + 2.0 ) - 3 ) < 0.1 );
+    }
+    auto same = uwc::compare< Engine, Agg, Delims >( small, index, 0 );
+    CHECK( same.jaccard() == 1 );
+    CHECK( same.jaccardExact() );
+
+    auto approx = uwc::compare< Engine, Agg, Delims >( small, sketch, 0 );
+    CHECK_FALSE( approx.commonExact );
+    CHECK( std::abs( approx.first - 5 ) < 0.1 );
+    CHECK( std::abs( approx.second - bigCount ) < bigCount * 0.03 );
+    for ( auto const& path : { small, big, index, sketch } )
+        std::filesystem::remove( path );
+}
+
+namespace {
+    // raw protocol client, reads time out so that broken server fails test instead of hanging it
+    class TestClient {
+        int fd_;
+
+      public:
+        explicit TestClient( std::filesystem::path const& socket ) : fd_( ::socket( AF_UNIX, SOCK_STREAM, 0 ) ) {
+            sockaddr_un addr{};
+            addr.sun_family = AF_UNIX;
+            std::strncpy( addr.sun_path, socket.c_str(), sizeof( addr.sun_path ) - 1 );
+            timeval timeout{ 5, 0 };
+            ::setsockopt( fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+            if ( ::connect( fd_, reinterpret_cast< sockaddr* >( &addr ), sizeof( addr ) ) < 0 )
+                throw std::runtime_error( "Cannot connect" );
+        }
+        ~TestClient() { ::close( fd_ ); }
+
+        void send( std::string_view data ) {
+            CHECK( ::send( fd_, data.data(), data.size(), MSG_NOSIGNAL ) == ssize_t( data.size() ) );
+        }
+
+        // response without newline, "" at end of connection, "TIMEOUT" when server does not answer
+        std::string line() {
+            std::string out;
+            char c;
+            while ( true ) {
+                auto n = ::recv( fd_, &c, 1, 0 );
+                if ( n < 0 )
+                    return errno == EAGAIN || errno == EWOULDBLOCK ? "TIMEOUT" : "";
+                if ( n == 0 || c == '\n' )
+                    return out;
+                out += c;
+            }
+        }
+    };
+
+    // slot counting fed pieces, so tests know when request holds its slot
+    class TestSlot : public uwc::CounterSlot< uwc::HashEngine, uwc::agg::DelayedSingle > {
+        std::atomic< int >& fed_;
+
+      public:
+        explicit TestSlot( std::atomic< int >& fed ) : CounterSlot( 2, 1024, 100 ), fed_( fed ) {}
+        void feed( std::string_view data ) override {
+            CounterSlot::feed( data );
+            ++fed_;
+        }
+    };
+
+    void waitFor( std::function< bool() > const& ready ) {
+        for ( int i = 0; i < 500 && !ready(); ++i )
+            std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    }
+} // namespace
+
+TEST_CASE( "server", "[server]" ) {
+    auto socket = tempFile( "uwc-test.sock" );
+    auto path = tempFile( "uwc-server.txt" );
+    std::ofstream( path, std::ios::binary ) << "a horse and a dog";
+
+    uwc::Server server( socket, 1, 4, [] {
+        return std::make_unique< uwc::CounterSlot< uwc::HashEngine, uwc::agg::DelayedSingle > >( 2, 1024, 100 );
+    }, false );
+    std::thread thread( [ & ] { server.run(); } );
+    for ( int i = 0; i < 100 && !std::filesystem::exists( socket ); ++i )
+        std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+
+    CHECK( uwc::requestCount( socket, path ) == "OK 4" );
+    CHECK( uwc::requestCount( socket, path ) == "OK 4" ); // slot was reset
+    CHECK( ( std::filesystem::status( socket ).permissions() & std::filesystem::perms::all )
+           == ( std::filesystem::perms::owner_read | std::filesystem::perms::owner_write ) );
+    CHECK_THAT( uwc::requestCount( socket, tempFile( "uwc-server-missing.txt" ) ), StartsWith( "ERROR Cannot open" ) );
+
+    server.stop();
+    thread.join();
+    std::filesystem::remove( path );
+    CHECK_THROWS_AS( uwc::requestCount( socket, path ), RE );
+}
+
+TEST_CASE( "server-protocol", "[server]" ) {
+    auto socket = tempFile( "uwc-test-protocol.sock" );
+    auto path = tempFile( "uwc-server-protocol.txt" );
+    std::ofstream( path, std::ios::binary ) << "a horse and a dog";
+    std::atomic< int > fed{ 0 };
+
+    SECTION( "requests" ) {
+        auto factory = [ & ] { return std::make_unique< TestSlot >( fed ); };
+        auto server = std::make_unique< uwc::Server >( socket, 1, 0, factory, false );
+        std::thread thread( [ & ] { server->run(); } );
+        waitFor( [ & ] { return std::filesystem::exists( socket ); } );
+
+        SECTION( "data" ) {
+            TestClient client( socket );
+            client.send( "DATA 11\none two " );
+            client.send( "oneDATA 0\n" );
+            CHECK( client.line() == "OK 2" );
+            CHECK( client.line() == "OK 0" ); // slot was reset
+            client.send( "FILE " + path.string() + "\nQUIT\n" );
+            CHECK( client.line() == "OK 4" );
+            CHECK( client.line() == "" );
+        }
+        SECTION( "stream" ) {
+            TestClient client( socket );
+            client.send( "STREAM\n6\nthe ho" );
+            client.send( "13\nrse and the d2\nog0\n" ); // words are split between chunks
+            CHECK( client.line() == "OK 4" );
+            client.send( "STREAM\n0\n" );
+            CHECK( client.line() == "OK 0" );
+        }
+        SECTION( "errors close data connections" ) {
+            {
+                TestClient client( socket );
+                client.send( "FILE " + tempFile( "uwc-server-missing.txt" ).string() + "\n" );
+                CHECK_THAT( client.line(), StartsWith( "ERROR Cannot open" ) );
+                client.send( "DATA x\na b" );
+                CHECK( client.line() == "ERROR Bad size 'x'" );
+                CHECK( client.line() == "" );
+            }
+            {
+                TestClient client( socket );
+                client.send( "STREAM\n3\na bx1\nFILE " + path.string() + "\n" );
+                CHECK( client.line() == "ERROR Bad size 'x1'" );
+                CHECK( client.line() == "" );
+            }
+            {
+                TestClient client( socket );
+                client.send( "HELLO\n" );
+                CHECK( client.line() == "ERROR Unknown request 'HELLO'" );
+                CHECK( client.line() == "" );
+            }
+        }
+        SECTION( "busy" ) {
+            TestClient blocking( socket );
+            blocking.send( "DATA 7\nthe " );
+            waitFor( [ & ] { return fed > 0; } ); // request holds the only slot, no queue
+            TestClient rejected( socket );
+            rejected.send( "FILE " + path.string() + "\n" );
+            CHECK( rejected.line() == "BUSY" );
+            CHECK( rejected.line() == "" );
+            CHECK( uwc::requestCount( socket, path ) == "BUSY" );
+            blocking.send( "cat" );
+            CHECK( blocking.line() == "OK 2" );
+            CHECK( uwc::requestCount( socket, path ) == "OK 4" );
+        }
+        SECTION( "stop with idle client" ) {
+            TestClient idle( socket );
+            CHECK( uwc::requestCount( socket, path ) == "OK 4" );
+            server->stop();
+            thread.join();
+            server.reset(); // waits for connection thread
+            CHECK( idle.line() == "" );
+        }
+        SECTION( "stop during request" ) {
+            TestClient blocking( socket );
+            blocking.send( "DATA 7\nthe " );
+            waitFor( [ & ] { return fed > 0; } );
+            server->stop();
+            thread.join();
+            server.reset(); // waits for connection thread
+            CHECK( blocking.line() == "" );
+        }
+        if ( server ) {
+            server->stop();
+            thread.join();
+        }
+    }
+    SECTION( "concurrent slots" ) {
+        uwc::Server server( socket, 2, 0, [ & ] { return std::make_unique< TestSlot >( fed ); }, false );
+        std::thread thread( [ & ] { server.run(); } );
+        waitFor( [ & ] { return std::filesystem::exists( socket ); } );
+
+        TestClient first( socket ), second( socket );
+        first.send( "DATA 7\nthe " );
+        second.send( "STREAM\n4\na b " );
+        waitFor( [ & ] { return fed > 1; } ); // both requests hold a slot
+        CHECK( uwc::requestCount( socket, path ) == "BUSY" );
+        second.send( "3\nc a0\n" );
+        CHECK( second.line() == "OK 3" );
+        first.send( "cat" );
+        CHECK( first.line() == "OK 2" );
+
+        server.stop();
+        thread.join();
+    }
+    std::filesystem::remove( path );
+}
@@ -22,9 +22,73 @@ for r in "${!repeats[@]}"; do
         $dir/uwc test/$name -agg multi
         $dir/uwc test/$name -agg delayed-single
         $dir/uwc test/$name -agg delayed-multi
+        $dir/uwc test/$name -engine flat
+        $dir/uwc test/$name -engine sort
+        $dir/uwc test/$name -engine sort -agg delayed-multi
     done
 done
 
+# hash policies
+for hash in std wy crc32c packed; do
+    $dir/uwc test/r50-100M.txt -engine hash -hash $hash
+    $dir/uwc test/r50-100M.txt -engine flat -hash $hash
+done
+
+# realistic distributions, counts are verified against ground truth written by gen
+check() {
+    local expected=$(cat $1.distinct)
+    local got=$($dir/uwc -quiet "${@:2}" $1)
+    if [ "$got" != "$expected" ]; then
+        echo "FAILED: uwc ${@:2} $1 counted $got, expected $expected"
+        exit 1
+    fi
+}
+for s in 0.8 1.1; do
+    name="zipf${s}-english-100M.txt"
+    echo "-------------------------------------------------------------"
+    $dir/gen -distinct=5M -zipf=$s -length=english test/$name 100M
+    check test/$name
+    check test/$name -engine flat
+    check test/$name -engine sort
+    check test/$name -agg delayed-multi
+    check test/$name -engine flat -bitmap 5
+    check test/$name -engine sort -bitmap 6
+done
+
+# dumped vocabulary is the same as from sort -u
+name="zipf1.1-english-100M.txt"
+tr -s ' \n' '\n\n' < test/$name | LC_ALL=C sort -u > test/$name.words
+for engine in hash flat sort; do
+    $dir/uwc -quiet test/$name -engine $engine -bitmap 5 -dump test/$name.dump -dump-sorted
+    cmp test/$name.words test/$name.dump || exit 1
+done
+
+# set operations are checked against comm of sorted word lists
+other="zipf0.8-english-100M.txt"
+tr -s ' \n' '\n\n' < test/$other | LC_ALL=C sort -u > test/$other.words
+expected=$(LC_ALL=C comm -12 test/$name.words test/$other.words | wc -l)
+for engine in hash flat sort; do
+    got=$($dir/uwc -quiet -intersect -engine $engine test/$name test/$other)
+    [ "$got" = "$expected" ] || { echo "FAILED: -intersect -engine $engine counted $got, expected $expected"; exit 1; }
+done
+$dir/uwc -save-index test/$name.uwi -save-sketch test/$name.hll test/$name
+$dir/uwc -diff test/$name.uwi test/$other
+$dir/uwc -jaccard test/$name.hll test/$other
+
+# per segment counts
+$dir/uwc test/$name -segment 10M
+$dir/uwc test/$name -segment 10M -engine flat -agg delayed-multi
+
+# workers reading ranges of file count the same
+expected=$($dir/uwc -quiet test/$name)
+for engine in hash flat sort; do
+    got=$($dir/uwc -quiet -pread -engine $engine test/$name)
+    [ "$got" = "$expected" ] || { echo "FAILED: -pread -engine $engine counted $got, expected $expected"; exit 1; }
+done
+# words longer than read buffer of -simple
+got=$($dir/uwc -quiet -simple -inbuf 8 test/$name)
+[ "$got" = "$expected" ] || { echo "FAILED: -simple -inbuf 8 counted $got, expected $expected"; exit 1; }
+
 # $dir/gen -repeat=20 test/r20-1G.txt 1G
 # $dir/uwc test/r20-1G.txt -simple
 # $dir/uwc test/r20-1G.txt -agg single
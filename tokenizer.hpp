@@ -0,0 +1,185 @@
+#ifndef TOKENIZER_HPP
+#define TOKENIZER_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+#ifdef __SSE2__
+#    include <emmintrin.h>
+#endif
+
+namespace util {
+
+    // Set of delimiter characters known at compile time,
+    // is() is a lookup in constexpr table (single comparison for single delimiter),
+    // mask() marks delimiters in 64 byte block (SSE2 comparisons where available).
+    template< char... Chars >
+    struct Delimiters {
+        static constexpr std::array< bool, 256 > table = [] {
+            std::array< bool, 256 > t{};
+            ( ( t[ static_cast< unsigned char >( Chars ) ] = true ), ... );
+            return t;
+        }();
+        static constexpr bool is( char c ) { return table[ static_cast< unsigned char >( c ) ]; }
+        static std::uint64_t mask( char const* block ) {
+#ifdef __SSE2__
+            std::uint64_t m = 0;
+            for ( unsigned i = 0; i < 64; i += 16 ) {
+                __m128i v = _mm_loadu_si128( reinterpret_cast< __m128i const* >( block + i ) );
+                __m128i eq = ( _mm_cmpeq_epi8( v, _mm_set1_epi8( Chars ) ) | ... );
+                m |= static_cast< std::uint64_t >( static_cast< unsigned >( _mm_movemask_epi8( eq ) ) ) << i;
+            }
+            return m;
+#else
+            std::uint64_t m = 0;
+            for ( unsigned i = 0; i < 64; ++i )
+                m |= static_cast< std::uint64_t >( is( block[ i ] ) ) << i;
+            return m;
+#endif
+        }
+    };
+
+    template< char C >
+    struct Delimiters< C > {
+        static constexpr bool is( char c ) { return c == C; }
+        static std::uint64_t mask( char const* block ) { return Delimiters< C, C >::mask( block ); }
+    };
+
+    using SpaceDelimiters = Delimiters< ' ' >; // input contract: words of 'a'..'z' separated by spaces
+    using WhitespaceDelimiters = Delimiters< ' ', '\t', '\n', '\r', '\v', '\f' >;
+
+    const std::size_t npos = std::string_view::npos;
+
+    template< typename D >
+    std::size_t findFirstDelimiter( std::string_view input, std::size_t pos = 0 ) {
+        for ( ; pos < input.size(); ++pos )
+            if ( D::is( input[ pos ] ) )
+                return pos;
+        return npos;
+    }
+
+    // find last delimiter at or before pos
+    template< typename D >
+    std::size_t findLastDelimiter( std::string_view input, std::size_t pos = npos ) {
+        if ( input.empty() )
+            return npos;
+        pos = pos < input.size() ? pos + 1 : input.size();
+        while ( pos-- > 0 )
+            if ( D::is( input[ pos ] ) )
+                return pos;
+        return npos;
+    }
+
+    // Word statistics collected while tokenizing: total words and histogram of lengths,
+    // the last bucket counts words of kMaxStatsLength or more characters.
+    struct WordStats {
+        static constexpr std::size_t kMaxStatsLength = 32;
+
+        std::size_t total = 0;
+        std::array< std::size_t, kMaxStatsLength + 1 > lengths{}; // index = length
+
+        void add( std::size_t length ) { ++lengths[ std::min( length, kMaxStatsLength ) ]; }
+        void merge( WordStats const& other ) {
+            total += other.total;
+            for ( std::size_t i = 0; i < lengths.size(); ++i )
+                lengths[ i ] += other.lengths[ i ];
+        }
+    };
+
+    namespace detail {
+        // Words are found from 64 byte delimiter masks: word starts are non delimiters preceded by delimiter,
+        // word ends are delimiters preceded by non delimiter. Starts and ends alternate, so words are
+        // emitted by taking lowest bits of both masks in turn, total is popcount of starts.
+        template< typename D, bool Stats, typename F >
+        void tokenize( std::string_view input, F&& f, WordStats* stats ) {
+            char const* data = input.data();
+            std::size_t size = input.size();
+            char const* start = nullptr; // start of word in progress
+            std::uint64_t prevDelim = 1; // delimiter before input
+            for ( std::size_t base = 0; base < size; base += 64 ) {
+                std::uint64_t delims;
+                if ( size - base >= 64 )
+                    delims = D::mask( data + base );
+                else {
+                    delims = ~std::uint64_t( 0 ) << ( size - base ); // past the end is delimiter
+                    for ( std::size_t i = base; i < size; ++i )
+                        delims |= static_cast< std::uint64_t >( D::is( data[ i ] ) ) << ( i - base );
+                }
+                std::uint64_t shifted = ( delims << 1 ) | prevDelim;
+                std::uint64_t starts = ~delims & shifted;
+                std::uint64_t ends = delims & ~shifted;
+                prevDelim = delims >> 63;
+                if constexpr ( Stats )
+                    stats->total += static_cast< std::size_t >( std::popcount( starts ) );
+                while ( true ) {
+                    if ( start ) {
+                        if ( !ends )
+                            break;
+                        char const* end = data + base + std::countr_zero( ends );
+                        ends &= ends - 1;
+                        if constexpr ( Stats )
+                            stats->add( static_cast< std::size_t >( end - start ) );
+                        f( std::string_view( start, static_cast< std::size_t >( end - start ) ) );
+                        start = nullptr;
+                    } else {
+                        if ( !starts )
+                            break;
+                        start = data + base + std::countr_zero( starts );
+                        starts &= starts - 1;
+                    }
+                }
+            }
+            if ( start ) { // last word ends with input (only when input size is multiple of 64)
+                if constexpr ( Stats )
+                    stats->add( static_cast< std::size_t >( data + size - start ) );
+                f( std::string_view( start, static_cast< std::size_t >( data + size - start ) ) );
+            }
+        }
+    } // namespace detail
+
+    // call f( std::string_view ) for each non empty word in input
+    template< typename D, typename F >
+    void forEachWord( std::string_view input, F&& f ) {
+        detail::tokenize< D, false >( input, std::forward< F >( f ), nullptr );
+    }
+
+    // as above, words are also counted to stats
+    template< typename D, typename F >
+    void forEachWord( std::string_view input, WordStats& stats, F&& f ) {
+        detail::tokenize< D, true >( input, std::forward< F >( f ), &stats );
+    }
+
+    // split input to count chunks similar in length,
+    // each chunk except last one ends with delimiter
+    template< typename D >
+    std::vector< std::string_view > splitToChunks( std::string_view input, unsigned count ) {
+        assert( count > 0 );
+        std::size_t chunkSize = input.size() / count + ( input.size() % count ? 1 : 0 );
+        if ( chunkSize < 2 )
+            return { input }; // single chunk
+
+        std::vector< std::string_view > res;
+        while ( true ) {
+            if ( res.size() == count - 1 ) {
+                res.push_back( input ); // last chunk
+                return res;
+            }
+            auto pos = findLastDelimiter< D >( input, chunkSize );
+            if ( pos == npos ) { // no delimiter -> last chunk
+                res.push_back( input );
+                return res;
+            }
+            res.emplace_back( input.data(), pos + 1 ); // up to and including delimiter
+            input.remove_prefix( pos + 1 );
+        }
+    }
+
+} // namespace util
+
+#endif
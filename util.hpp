@@ -1,6 +1,7 @@
 #ifndef UTIL_HPP
 #define UTIL_HPP
 
+#include "mem.hpp"
 #include <cassert>
 #include <cstring>
 #include <filesystem>
@@ -18,15 +19,21 @@ namespace util {
 
     bool helper( std::string const& input );
 
+    // memory comes from allocLarge() when huge pages are enabled (at construction), from new[] otherwise
     class Buffer {
       public:
-        Buffer( std::size_t size ) {
+        Buffer( std::size_t size ) : large_( hugePagesEnabled() ) {
             if ( size == 0 )
                 throw std::runtime_error( "Buffer size must be greater than 0" );
-            data_ = new char[ size ];
+            data_ = large_ ? static_cast< char* >( allocLarge( size ) ) : new char[ size ];
             size_ = size;
         }
-        ~Buffer() { delete[] data_; }
+        ~Buffer() {
+            if ( large_ )
+                freeLarge( data_, size_ );
+            else
+                delete[] data_;
+        }
 
         std::size_t size() const { return size_; }
         char* ptr() const { return data_; }
@@ -69,15 +76,12 @@ namespace util {
         char* data_;
         std::size_t size_ = 0;
         std::size_t valid_ = 0; // valid characters in buffer
+        bool large_;            // allocated by allocLarge()
 
         Buffer( Buffer& );
         Buffer& operator=( Buffer& );
     };
 
-    // split buffer to count chunks similar in length,
-    // each chunk except last one ends with separator
-    std::vector< std::string_view > splitToChunks( std::string_view input, unsigned count, char separator = ' ' );
-
     // support K(ilo),M(ega),G(iga), case insensitive
     std::size_t parseNumberWithOptionalSuffix( std::string const& input );
 
@@ -1,190 +1,52 @@
+#include "counter.hpp"
+#include "dump.hpp"
+#include "input.hpp"
+#include "mem.hpp"
+#include "server.hpp"
+#include "setops.hpp"
+#include "tokenizer.hpp"
 #include "util.hpp"
-#include <atomic>
-#include <condition_variable>
+#include <chrono>
+#include <cmath>
 #include <cstdio>
-#include <cstring>
 #include <filesystem>
+#include <iomanip>
 #include <iostream>
 #include <optional>
 #include <string>
-#include <thread>
-#include <unordered_set>
-
-namespace {
-// #define Logging 1
-#ifdef Logging
-    std::mutex logMutex_;
-    [[maybe_unused]]
-    void log( char const* what ) {
-        std::unique_lock lock( logMutex_ );
-        // std::cout << std::this_thread::get_id() << ": ";
-        std::cout << what << std::endl;
-    }
-    [[maybe_unused]]
-    void log( std::string const& what ) {
-        std::unique_lock lock( logMutex_ );
-        // std::cout << std::this_thread::get_id() << ": ";
-        std::cout << what << std::endl;
-    }
-    template< typename... ARGS >
-    void log( ARGS const&... args ) {
-        std::unique_lock lock( logMutex_ );
-        // std::cout << std::this_thread::get_id() << ": ";
-        ( std::cout << ... << args ) << std::endl;
-    }
-#else
-    [[maybe_unused]] void log( char const* ) {}
-    template< typename... ARGS >
-    void log( ARGS const&... ) {}
-
-#endif
-} // namespace
 
 namespace uwc {
 
-    // to enable heterogenous lookup by string_view or const char*
-    struct string_hash {
-        using is_transparent = void;
-        [[nodiscard]] size_t operator()( const char* txt ) const { return std::hash< std::string_view >{}( txt ); }
-        [[nodiscard]] size_t operator()( std::string_view txt ) const { return std::hash< std::string_view >{}( txt ); }
-        [[nodiscard]] size_t operator()( const std::string& txt ) const { return std::hash< std::string >{}( txt ); }
-    };
-    using Words = std::unordered_set< std::string, string_hash, std::equal_to<> >;
-
-    const auto npos = std::string_view::npos;
-
-    class Worker {
-      public:
-        explicit Worker( int id, Words const& final, std::atomic< unsigned >& done )
-            : id_( id ), done_( done ), finalWords_( final ), thread_( &Worker::process, this ) {}
-        ~Worker() {
-            // log( "~worker()", id_ );
-            stop();
-        }
-        void stop() {
-            {
-                std::unique_lock lock( m_ );
-                state_ = Exit;
-                cv_.notify_one();
-            }
-            thread_.join();
-            log( id_, ": Worker stopped." );
-        }
-
-        void run( std::string_view input, bool clear ) {
-            std::unique_lock lock( m_ );
-            if ( clear )
-                words_.clear();
-            data_ = input;
-            mergeWith_ = nullptr;
-            if ( data_.empty() ) {
-                state_ = Done;
-                done_.fetch_add( 1, std::memory_order_release );
-            } else {
-                state_ = Go;
-                cv_.notify_one();
-            }
-        }
-
-        Words const& getWords() const {
-            assert( state_ == Done );
-            return words_;
-        }
-
-        Words& useWords() { return words_; }
-
-        void mergeWith( Worker& other ) {
-            std::unique_lock lock( m_ );
-            mergeWith_ = &other;
-            state_ = Go;
-            cv_.notify_one();
-        }
-        int id() const { return id_; }
-
-      private:
-        bool goOrExit() const { return state_ == Go || state_ == Exit; }
-        void process() {
-            log( id_, ": Worker wait for data" );
-            { // wait for data
-                std::unique_lock lock( m_ );
-                while ( !goOrExit() )
-                    cv_.wait( lock );
-                if ( state_ == Exit ) {
-                    log( id_, ": Worker process() exit" );
-                    return;
-                }
-            }
-            while ( true ) {
-                if ( mergeWith_ ) {
-                    log( id_, ": Merge ", mergeWith_->id_, " into ", id_ );
-                    words_.merge( mergeWith_->words_ );
-                } else {
-                    /// log( id_, ": Worker processing data..." );
-                    while ( !data_.empty() ) {
-                        // skip spaces/tabs/newlines before word
-                        auto idx = data_.find_first_not_of( " \t\n" );
-                        if ( idx != npos )
-                            data_.remove_prefix( idx );
-                        // find end of the word
-                        idx = data_.find_first_of( " \t\n" );
-                        if ( idx == npos ) {
-                            // no delimiter -> last word
-                            /// log( id_, ": got word '", word, "'" );
-                            if ( !data_.empty() ) {
-                                if ( !finalWords_.contains( std::string( data_ ) ) )
-                                    words_.emplace( data_ );
-                            }
-                            break;
-                        }
-                        std::string_view word( data_.data(), idx );
-                        if ( !word.empty() ) {
-                            // log( id_, ": got word '", word, "'" );
-                            if ( !finalWords_.contains( std::string( word ) ) )
-                                words_.emplace( word ); // put word into set
-                        }
-                        data_.remove_prefix( idx + 1 ); // remove word and delimiter from input
-                    }
-                    /// log( id_, ": Worker data processed" );
-                }
-
-                /*unsigned d = */ done_.fetch_add( 1, std::memory_order_release );
-                /// log( id_, ": ", words_.size(), " unique words, doneCounter: ", d + 1 );
-                std::unique_lock lock( m_ );
-                state_ = Done;
-                // wait for next chunk or exit
-                while ( !goOrExit() )
-                    cv_.wait( lock );
-                if ( state_ == Exit ) {
-                    log( id_, ": Worker process() exit" );
-                    return;
-                }
-            }
-        }
-
-        [[maybe_unused]] int id_; // used in logging only
-        std::atomic< unsigned >& done_;
-        Words const& finalWords_;
-
-        enum State { Wait, Go, Done, Exit };
-        State state_ = Wait;
-
-        std::string_view data_;
-        Words words_;
-        std::thread thread_;
-        mutable std::mutex m_;
-        mutable std::condition_variable cv_;
-
-        Worker* mergeWith_ = nullptr;
-    };
-
     class App {
         std::filesystem::path in_;
+        std::filesystem::path in2_; // second operand of set operation
         const std::size_t defaultInBufSize_ = 256 * util::kMB;
         const std::size_t minInBufSize_ = 4;
         const std::size_t maxInBufSize_ = util::kGB;
         std::size_t inBufSize_ = defaultInBufSize_;
         bool simple_ = false;
         bool verbose_ = true;
+        bool hugePages_ = false;
+        enum EngineMode { Hash, Flat, Sort };
+        EngineMode engine_ = Hash;
+        enum HashMode { DefaultHash, StdHash, WyHash, Crc32cHash, PackedHash };
+        HashMode hash_ = DefaultHash; // std for hash engine, wy for flat engine
+        unsigned shortWords_ = 0;     // words up to this length go to shared bitmap
+        bool spaceOnly_ = false; // words delimited by spaces only, otherwise by any whitespace
+        std::optional< std::filesystem::path > serve_;  // socket to serve on
+        std::optional< std::filesystem::path > client_; // socket to send request to
+        unsigned slots_ = 2;                            // concurrent requests of server
+        std::size_t queue_ = 16;                        // requests waiting for free slot
+        std::size_t reserve_ = 0;                       // unique words to prepare server slots for
+        std::optional< std::filesystem::path > dump_;   // file to write unique words to
+        bool dumpSorted_ = false;
+        std::optional< std::filesystem::path > saveIndex_;  // file to write sorted unique words to (.uwi)
+        std::optional< std::filesystem::path > saveSketch_; // file to write sketch of unique words to (.hll)
+        enum SetOperation { NoSetOperation, Diff, Intersect, Jaccard };
+        SetOperation setOperation_ = NoSetOperation;
+        std::size_t segment_ = 0; // bytes of input per segment reported separately
+        bool perf_ = false;       // hardware counters per phase
+        bool pread_ = false;      // workers read ranges of plain input file
 
         enum AggregateMode { SingleThread, MultiThread, DelayedSingle, DelayedMulti };
         AggregateMode agg_ = DelayedSingle;
@@ -192,7 +54,21 @@ namespace uwc {
       public:
         App() {}
 
-        void usage() { std::cout << "Usage: uwc [-quiet] [-agg single|multi|delayed-single|delayed-multi] [-inbuf <read_buffer_size] <input_path>\n"; }
+        void usage() {
+            std::cout << "Usage: uwc [-quiet] [-hugepages] [-agg single|multi|delayed-single|delayed-multi] "
+                         "[-delim space|whitespace]\n"
+                         "           [-engine hash|flat|sort] [-hash std|wy|crc32c|packed] [-bitmap <max_length>]\n"
+                         "           [-inbuf <read_buffer_size] [-dump <output_path> [-dump-sorted]]\n"
+                         "           [-segment <segment_size>] [-perf] [-pread] "
+                         "<input_path(.gz|.zst)>\n"
+                         "       uwc -diff|-intersect|-jaccard [options above] <input_path|index.uwi|sketch.hll> "
+                         "<input_path|index.uwi|sketch.hll>\n"
+                         "           (-diff A B is exact when A is the smaller file, otherwise may be estimated: ~)\n"
+                         "       uwc [options above] [-save-index <index.uwi>] [-save-sketch <sketch.hll>] <input_path>\n"
+                         "       uwc -serve <socket> [-slots <concurrent_requests>] [-queue <waiting_requests>] "
+                         "[-reserve <words>] [options above]\n"
+                         "       uwc -client <socket> <input_path|->\n";
+        }
 
         bool processCmdline( int argc, char** argv ) {
             std::string sw, arg;
@@ -204,10 +80,31 @@ namespace uwc {
                         simple_ = true;
                     else if ( arg == "-quiet" )
                         verbose_ = false;
-                    else if ( arg == "-inbuf" || arg == "-agg" )
+                    else if ( arg == "-hugepages" )
+                        hugePages_ = true;
+                    else if ( arg == "-dump-sorted" )
+                        dumpSorted_ = true;
+                    else if ( arg == "-perf" )
+                        perf_ = true;
+                    else if ( arg == "-pread" )
+                        pread_ = true;
+                    else if ( arg == "-diff" )
+                        setOperation_ = Diff;
+                    else if ( arg == "-intersect" )
+                        setOperation_ = Intersect;
+                    else if ( arg == "-jaccard" )
+                        setOperation_ = Jaccard;
+                    else if ( arg == "--serve" )
+                        sw = "-serve";
+                    else if ( arg == "-inbuf" || arg == "-agg" || arg == "-delim" || arg == "-engine" || arg == "-hash"
+                              || arg == "-bitmap" || arg == "-serve" || arg == "-client" || arg == "-slots" || arg == "-queue"
+                              || arg == "-reserve" || arg == "-dump" || arg == "-save-index" || arg == "-save-sketch"
+                              || arg == "-segment" )
                         sw = arg;
                     else if ( !inPath )
                         inPath = arg;
+                    else if ( setOperation_ != NoSetOperation && in2_.empty() )
+                        in2_ = arg;
                     else {
                         std::cerr << "Unexpected argument '" << arg << "'\n";
                         return false;
@@ -226,6 +123,82 @@ namespace uwc {
                                       << " .. " << maxInBufSize_ << " (bytes)\n";
                             return false;
                         }
+                    } else if ( sw == "-engine" ) {
+                        if ( arg == "hash" )
+                            engine_ = Hash;
+                        else if ( arg == "flat" )
+                            engine_ = Flat;
+                        else if ( arg == "sort" )
+                            engine_ = Sort;
+                        else {
+                            std::cerr << "Bad value of -engine switch '" << arg << "', should be hash, flat or sort\n";
+                            return false;
+                        }
+                    } else if ( sw == "-hash" ) {
+                        if ( arg == "std" )
+                            hash_ = StdHash;
+                        else if ( arg == "wy" )
+                            hash_ = WyHash;
+                        else if ( arg == "crc32c" )
+                            hash_ = Crc32cHash;
+                        else if ( arg == "packed" )
+                            hash_ = PackedHash;
+                        else {
+                            std::cerr << "Bad value of -hash switch '" << arg << "', should be std, wy, crc32c or packed\n";
+                            return false;
+                        }
+                    } else if ( sw == "-bitmap" ) {
+                        char maxLength = static_cast< char >( '0' + ShortWords::kMaxLength );
+                        if ( arg.size() != 1 || arg[ 0 ] < '0' || arg[ 0 ] > maxLength ) {
+                            std::cerr << "Bad value of -bitmap switch '" << arg << "', should be in range 0 .. "
+                                      << ShortWords::kMaxLength << "\n";
+                            return false;
+                        }
+                        shortWords_ = static_cast< unsigned >( arg[ 0 ] - '0' );
+                    } else if ( sw == "-delim" ) {
+                        if ( arg == "space" )
+                            spaceOnly_ = true;
+                        else if ( arg == "whitespace" )
+                            spaceOnly_ = false;
+                        else {
+                            std::cerr << "Bad value of -delim switch '" << arg << "', should be space or whitespace\n";
+                            return false;
+                        }
+                    } else if ( sw == "-serve" ) {
+                        serve_ = arg;
+                    } else if ( sw == "-client" ) {
+                        client_ = arg;
+                    } else if ( sw == "-dump" ) {
+                        dump_ = arg;
+                    } else if ( sw == "-save-index" ) {
+                        saveIndex_ = arg;
+                    } else if ( sw == "-save-sketch" ) {
+                        saveSketch_ = arg;
+                    } else if ( sw == "-segment" ) {
+                        try {
+                            segment_ = util::parseNumberWithOptionalSuffix( arg );
+                        } catch ( std::exception const& e ) {
+                            std::cerr << "Bad segment size: " << e.what() << "\n";
+                            return false;
+                        }
+                    } else if ( sw == "-slots" || sw == "-queue" || sw == "-reserve" ) {
+                        std::size_t value = 0;
+                        try {
+                            value = util::parseNumberWithOptionalSuffix( arg );
+                        } catch ( std::exception const& e ) {
+                            std::cerr << "Bad value of " << sw << " switch: " << e.what() << "\n";
+                            return false;
+                        }
+                        if ( sw == "-slots" ) {
+                            if ( value < 1 || value > 1024 ) {
+                                std::cerr << "Bad value of -slots switch " << value << ", should be in range 1 .. 1024\n";
+                                return false;
+                            }
+                            slots_ = static_cast< unsigned >( value );
+                        } else if ( sw == "-queue" )
+                            queue_ = value;
+                        else
+                            reserve_ = value;
                     } else if ( sw == "-agg" ) {
                         if ( arg == "single" )
                             agg_ = SingleThread;
@@ -244,60 +217,120 @@ namespace uwc {
                     sw.clear();
                 }
             }
+            if ( !sw.empty() ) {
+                std::cerr << "Error: Missing value of " << sw << " switch\n";
+                return false;
+            }
+            if ( hash_ != DefaultHash && engine_ == Sort ) {
+                std::cerr << "Error: -hash cannot be used with -engine sort\n";
+                return false;
+            }
+            if ( dumpSorted_ && !dump_ ) {
+                std::cerr << "Error: -dump-sorted requires -dump\n";
+                return false;
+            }
+            if ( dump_ && ( serve_ || client_ || simple_ ) ) {
+                std::cerr << "Error: -dump cannot be used with -serve, -client nor -simple\n";
+                return false;
+            }
+            if ( ( saveIndex_ || saveSketch_ || segment_ || perf_ || pread_ ) && ( serve_ || client_ || simple_ ) ) {
+                std::cerr << "Error: -save-index, -save-sketch, -segment, -perf and -pread cannot be used with -serve, "
+                             "-client nor -simple\n";
+                return false;
+            }
+            if ( pread_ && segment_ ) {
+                std::cerr << "Error: -pread cannot be used with -segment\n";
+                return false;
+            }
+            if ( setOperation_ != NoSetOperation ) {
+                if ( !inPath || in2_.empty() ) {
+                    std::cerr << "Error: Specify two inputs to compare\n";
+                    return false;
+                }
+                if ( serve_ || client_ || simple_ || dump_ || saveIndex_ || saveSketch_ || segment_ || perf_ || pread_ ) {
+                    std::cerr << "Error: -diff, -intersect and -jaccard take only counting options\n";
+                    return false;
+                }
+            }
+            if ( serve_ && client_ ) {
+                std::cerr << "Error: -serve and -client cannot be used together\n";
+                return false;
+            }
+            if ( serve_ ) {
+                if ( inPath || simple_ ) {
+                    std::cerr << "Error: -serve doesn't take input file nor -simple\n";
+                    return false;
+                }
+                util::enableHugePages( hugePages_ );
+                return true;
+            }
             if ( !inPath ) {
                 std::cerr << "Error: Specify input file\n";
                 return false;
             }
             in_ = *inPath;
+            util::enableHugePages( hugePages_ ); // before any buffer or set allocation
             return true;
         }
+        void printCounts( std::size_t unique, util::WordStats const& stats ) {
+            std::cout << "File " << in_.string() << " contains " << unique << " unique words, total " << stats.total;
+            if ( stats.total > 0 )
+                std::cout << " (unique/total " << static_cast< double >( unique ) / static_cast< double >( stats.total ) << ")";
+            std::cout << "\nWord lengths:";
+            for ( std::size_t len = 1; len < stats.lengths.size(); ++len )
+                if ( stats.lengths[ len ] > 0 )
+                    std::cout << " " << len << ( len == util::WordStats::kMaxStatsLength ? "+" : "" ) << ":"
+                              << stats.lengths[ len ];
+            std::cout << "\n";
+        }
+
+        // reference implementation: single thread, single set
+        template< typename Delims >
         int countSimple() {
-            // single thread, single set
-            std::ifstream input( in_, std::ios::binary );
-            if ( !input ) {
-                std::cerr << "Error: Cannot open input file: " << in_.string() << "." << std::endl;
-                return 1;
-            }
             auto startTime = std::chrono::steady_clock::now();
+            auto input = util::openInput( in_, 1 );
             if ( verbose_ ) {
                 std::cout << "================================================\n";
-                std::cout << "Processing file (-simple) " << in_.string() << "..." << std::endl;
+                std::cout << "Processing file (-simple) " << in_.string() << " (" << input->describe() << ")..." << std::endl;
             }
             Words words;
-            std::size_t total = 0;
+            util::WordStats stats;
 
             util::Buffer buf( inBufSize_ );
+            std::string carry; // partial word filling whole buffer in previous rounds
             bool allDone = false;
             while ( !allDone ) {
-                input.read( buf.storageStart(), buf.storageSize() );
-                buf.addValid( input.gcount() );
-                if ( input.eof() )
+                buf.addValid( input->read( buf.storageStart(), buf.storageSize() ) );
+                if ( input->eof() )
                     allDone = true;
                 std::string_view data = buf.view();
-                // process data up to last space
-                while ( true ) {
-                    auto idx = data.find_first_not_of( " \t\n" );
-                    if ( idx != npos )
-                        data.remove_prefix( idx );
-                    // find end of the word
-                    idx = data.find_first_of( " \t\n" );
-                    if ( idx == npos ) {
-                        if ( allDone ) {
-                            if ( !data.empty() ) {
-                                ++total;
-                                words.emplace( data ); // put last word into set
-                            }
-                        } else
-                            buf.reset( data.size() ); // keep in buffer
-                        break;
-                    } else {
-                        std::string_view word( data.data(), idx );
-                        ++total;
-                        /// log( id_, ": got word '", word, "'" );
-                        words.emplace( word );         // put word into set
-                        data.remove_prefix( idx + 1 ); // remove word and delimiter from input
+                // process data up to last delimiter, keep the rest for next round
+                std::size_t keep = 0;
+                if ( !allDone ) {
+                    auto last = util::findLastDelimiter< Delims >( data );
+                    if ( last == npos ) { // no complete word yet
+                        carry.append( data );
+                        if ( buf.valid() > 0 )
+                            buf.reset();
+                        continue;
                     }
+                    keep = data.size() - last - 1;
+                    data.remove_suffix( keep );
                 }
+                if ( !carry.empty() ) {
+                    auto idx = std::min( util::findFirstDelimiter< Delims >( data ), data.size() );
+                    carry.append( data.substr( 0, idx ) );
+                    data.remove_prefix( idx );
+                    ++stats.total;
+                    stats.add( carry.size() );
+                    words.emplace( carry );
+                    carry.clear();
+                }
+                util::forEachWord< Delims >( data, stats, [ & ]( std::string_view word ) {
+                    words.emplace( word ); // put word into set
+                } );
+                if ( !allDone )
+                    buf.reset( keep );
             }
             if ( verbose_ ) {
                 auto stopTime = std::chrono::steady_clock::now();
@@ -308,7 +341,9 @@ namespace uwc {
                     std::cout << "!!! Done in " << dur.count() << " milliseconds.\n";
                 } else
                     std::cout << "!!! Done in " << sec.count() << " seconds.\n";
-                std::cout << "File " << in_.string() << " contains " << words.size() << " unique words, total " << total << "\n";
+                printCounts( words.size(), stats );
+                if ( hugePages_ )
+                    std::cout << "Huge pages: " << util::toString( util::hugePageStats() ) << "\n";
             } else {
                 std::cout << words.size() << "\n";
             }
@@ -317,150 +352,94 @@ namespace uwc {
             return 0;
         }
 
-        int countUniqueWords() {
-            const unsigned cpuCores = std::thread::hardware_concurrency() + 1;
-            log( "Cores: ", cpuCores );
-
-            std::ifstream input( in_, std::ios::binary );
-            if ( !input ) {
-                std::cerr << "Error: Cannot open input file: " << in_.string() << "." << std::endl;
-                return 1;
-            }
-            auto startTime = std::chrono::steady_clock::now();
-            if ( verbose_ ) {
-                std::cout << "================================================\n";
-                std::cout << "Processing file " << in_.string() << "..." << std::endl;
-                if ( agg_ == SingleThread )
-                    std::cout << "Aggregate in single thread" << std::endl;
-                else if ( agg_ == MultiThread )
-                    std::cout << "Aggregate in multiple threads" << std::endl;
-                else if ( agg_ == DelayedSingle )
-                    std::cout << "Aggregate in single thread after processing all data" << std::endl;
-                else // if ( agg_ == DelayedMulti )
-                    std::cout << "Aggregate in multiple threads after processing all data" << std::endl;
+        template< typename Delims >
+        int dispatch() {
+            if ( simple_ )
+                return countSimple< Delims >();
+            switch ( engine_ ) {
+                case Flat:
+                    return hash_ == DefaultHash ? dispatch< FlatEngine, Delims >() : dispatchHash< BasicFlatEngine, Delims >();
+                case Sort: return dispatch< SortEngine, Delims >();
+                default:
+                    return hash_ == DefaultHash ? dispatch< HashEngine, Delims >() : dispatchHash< BasicHashEngine, Delims >();
             }
+        }
 
-            Words finalSet;
-            std::vector< std::unique_ptr< Worker > > workers;
-            std::vector< Worker* > toMerge;
-            toMerge.reserve( cpuCores );
-
-            std::atomic< unsigned > doneCounter{};
-            for ( std::size_t i = 0; i < cpuCores; ++i )
-                workers.emplace_back( new Worker( i, finalSet, doneCounter ) );
-
-            util::Buffer buf( inBufSize_ );
-            bool allDone = false;
-            std::size_t keep = 0;
-            [[maybe_unused]] std::size_t round = 0;
-            log( "Read buffer size: ", buf.size() );
+        template< template< typename > class Engine, typename Delims >
+        int dispatchHash() {
+            switch ( hash_ ) {
+                case StdHash: return dispatch< Engine< hash::Std >, Delims >();
+                case Crc32cHash: return dispatch< Engine< hash::Crc32c >, Delims >();
+                case PackedHash: return dispatch< Engine< hash::Packed >, Delims >();
+                default: return dispatch< Engine< hash::Wy >, Delims >();
+            }
+        }
 
-            while ( !allDone ) {
-                log( "Read input (round ", round, ")..." );
-                input.read( buf.storageStart(), buf.storageSize() );
-                buf.addValid( input.gcount() );
-                // log( input.gcount(), " bytes read, ", buf.valid(), " bytes available" );
-                if ( input.eof() )
-                    allDone = true;
-                std::string_view data = buf.view();
-                if ( input.eof() )
-                    keep = 0; // no more data in file, process whole buffer
-                else {
-                    // find last space in buffer, process data up to this space in this round
-                    auto pos = data.find_last_of( ' ' );
-                    if ( pos == npos )
-                        throw std::runtime_error( "Input buffer to small" );
-                    keep = buf.valid() - pos - 1; // -1 to skip space
-                    data.remove_suffix( keep );
-                }
-                auto chunks = util::splitToChunks( data, cpuCores );
-                //// for ( auto c : chunks )
-                ////     log( "CHUNK|", c, "|" );
+        template< typename Engine, typename Delims >
+        int dispatch() {
+            switch ( agg_ ) {
+                case SingleThread: return dispatch< Engine, agg::Single, Delims >();
+                case MultiThread: return dispatch< Engine, agg::Multi, Delims >();
+                case DelayedSingle: return dispatch< Engine, agg::DelayedSingle, Delims >();
+                default: return dispatch< Engine, agg::DelayedMulti, Delims >();
+            }
+        }
 
-                // run workers
-                doneCounter = 0;
-                toMerge.clear();
-                std::size_t usedWorkers = chunks.size();
-                for ( std::size_t i = 0; i < usedWorkers; ++i ) {
-                    workers[ i ]->run( chunks[ i ], ( agg_ == SingleThread || agg_ == MultiThread ) );
-                    toMerge.push_back( workers[ i ].get() );
-                }
+        template< typename Engine, typename Aggregation, typename Delims >
+        int dispatch() {
+            if ( serve_ )
+                return serve< Engine, Aggregation, Delims >();
+            if ( setOperation_ != NoSetOperation )
+                return compareInputs< Engine, Aggregation, Delims >();
+            return countUniqueWords< Engine, Aggregation, Delims >();
+        }
 
-                log( "wait for workers ", usedWorkers );
-                // wait for workers to finish
-                while ( doneCounter.load( std::memory_order_acquire ) < usedWorkers )
-                    std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+        template< typename Engine, typename Aggregation, typename Delims >
+        int serve() {
+            // cores are shared by slots
+            unsigned threads = std::max( 1u, std::thread::hardware_concurrency() / slots_ ) + 1;
+            Server server( *serve_, slots_, queue_, [ & ] {
+                return std::make_unique< CounterSlot< Engine, Aggregation, Delims > >( threads, inBufSize_, reserve_,
+                                                                                       shortWords_ );
+            }, verbose_ );
+            server.run();
+            return 0;
+        }
 
-                if ( agg_ == SingleThread ) {
-                    log( "aggregate results in single thread" );
-                    for ( std::size_t i = 0; i < usedWorkers; ++i )
-                        finalSet.merge( workers[ i ]->useWords() );
-                } else if ( agg_ == MultiThread ) {
-                    // pairwise in multiple threads
-                    log( "aggregate results in multiple threads" );
-                    while ( toMerge.size() > 1 ) {
-                        auto first = toMerge.begin();
-                        auto last = --toMerge.end();
-                        doneCounter = 0;
-                        std::size_t expected = 0;
-                        while ( first < last ) {
-                            ( *first )->mergeWith( **last );
-                            ++first;
-                            --last;
-                            ++expected;
-                        }
-                        // wait for workers to finish
-                        log( "wait for ", expected, " workers" );
-                        while ( doneCounter.load( std::memory_order_acquire ) < expected )
-                            std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
-                        toMerge.erase( std::prev( toMerge.end(), expected ), toMerge.end() );
-                    }
-                    finalSet.merge( workers[ 0 ]->useWords() );
-                }
-                buf.reset( keep );
-                log( "'", buf.view(), "' kept to process in next round" );
-                ++round;
+        template< typename Engine, typename Aggregation, typename Delims >
+        int countUniqueWords() {
+            auto startTime = std::chrono::steady_clock::now();
+            Counter< Engine, Aggregation, Delims > counter( 0, inBufSize_ );
+            counter.useShortWords( shortWords_ );
+            counter.useSegments( segment_ );
+            counter.usePerf( perf_ );
+            // compressed input is decoded by its own threads, pipelined with workers
+            std::unique_ptr< util::Input > input;
+            if ( pread_ && util::detectCompression( in_ ) != util::Compression::None ) {
+                std::cerr << "Error: -pread needs uncompressed input\n";
+                return 1;
             }
-            if ( agg_ == DelayedSingle ) {
-                log( "Delayed Merge start" );
-                if ( workers.size() > 0 ) {
-                    finalSet = std::move( workers[ 0 ]->useWords() );
-                    for ( std::size_t i = 1; i < workers.size(); ++i ) {
-                        log( "Merge ", workers[ i ]->id(), "into final set" );
-                        finalSet.merge( workers[ i ]->useWords() );
-                    }
-                }
-                log( "Delayed Merge done" );
-            } else if ( agg_ == DelayedMulti ) {
-                // pairwise in multiple threads
-                log( "Delayed Merge start" );
-                toMerge.clear();
-                if ( workers.size() > 0 ) {
-                    finalSet = std::move( workers[ 0 ]->useWords() );
-                    for ( std::size_t i = 1; i < workers.size(); ++i )
-                        toMerge.push_back( workers[ i ].get() );
-                }
-                while ( toMerge.size() > 1 ) {
-                    auto first = toMerge.begin();
-                    auto last = --toMerge.end();
-                    doneCounter = 0;
-                    std::size_t expected = 0;
-                    while ( first < last ) {
-                        ( *first )->mergeWith( **last );
-                        ++first;
-                        --last;
-                        ++expected;
-                    }
-                    // wait for workers to finish
-                    while ( doneCounter.load( std::memory_order_acquire ) < expected )
-                        std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
-                    toMerge.erase( std::prev( toMerge.end(), expected ), toMerge.end() );
-                }
-                log( "Merge ", toMerge[ 0 ]->id(), " into final set" );
-                finalSet.merge( toMerge[ 0 ]->useWords() );
+            if ( !pread_ )
+                input = util::openInput( in_, counter.threads() - 1 );
+            if ( verbose_ ) {
+                std::cout << "================================================\n";
+                std::cout << "Processing file " << in_.string() << " (";
+                if ( input )
+                    std::cout << input->describe();
+                else
+                    std::cout << "plain, ranges read by " << counter.threads() << " workers";
+                std::cout << ")..." << std::endl;
+                std::cout << Aggregation::description << ", " << Engine::name << " engine, " << Engine::hashName << " hash";
+                if ( auto bitmap = counter.shortWords() )
+                    std::cout << ", bitmap of words up to " << bitmap->maxLength() << " letters ("
+                              << bitmap->bytes() / 1024 << "KB)";
+                std::cout << std::endl;
             }
-
-            workers.clear(); // stop and join worker threads
+            if ( input )
+                counter.feedInput( *input );
+            else
+                counter.feedFileRanges( in_ );
+            auto count = counter.count();
 
             if ( verbose_ ) {
                 auto stopTime = std::chrono::steady_clock::now();
@@ -470,10 +449,116 @@ namespace uwc {
                     std::cout << "!!! Done in " << dur.count() << " milliseconds.\n";
                 } else
                     std::cout << "!!! Done in " << sec.count() << " seconds.\n";
-                std::cout << "File " << in_.string() << " contains " << finalSet.size() << " unique words, total ???\n";
+                printCounts( count, counter.stats() );
             } else {
-                std::cout << finalSet.size() << "\n";
+                std::cout << count << "\n";
+            }
+            if ( perf_ )
+                printPerf( *counter.perfCounters(), counter.perfCounts() );
+            printSegments( counter.segments() );
+            if ( dump_ ) {
+                auto dumpStart = std::chrono::steady_clock::now();
+                auto written = dumpWords( counter, *dump_, dumpSorted_ );
+                if ( verbose_ ) {
+                    std::chrono::duration< float > sec = std::chrono::steady_clock::now() - dumpStart;
+                    std::cout << "Dumped " << written << ( dumpSorted_ ? " sorted" : "" ) << " words to " << dump_->string()
+                              << " in " << sec.count() << " seconds.\n";
+                }
+            }
+            if ( saveIndex_ ) {
+                dumpWords( counter, *saveIndex_, true );
+                if ( verbose_ )
+                    std::cout << "Index saved to " << saveIndex_->string() << "\n";
+            }
+            if ( saveSketch_ ) {
+                Sketch sketch;
+                counter.forEachWord( [ & ]( std::string_view word ) { sketch.add( word ); } );
+                sketch.save( *saveSketch_ );
+                if ( verbose_ )
+                    std::cout << "Sketch saved to " << saveSketch_->string() << " (estimate " << sketch.estimate() << ")\n";
+            }
+            if ( verbose_ && hugePages_ )
+                std::cout << "Huge pages: " << util::toString( util::hugePageStats() ) << "\n";
+            return 0;
+        }
+
+        // one line per phase, times and counts summed over threads; events the kernel forbids are reported once
+        void printPerf( util::PerfCounters const& counters, PhaseCounts const& counts ) {
+            std::cout << "Phase     time[ms]";
+            for ( auto name : util::kPerfEventNames )
+                std::cout << " " << std::setw( 14 ) << name;
+            std::cout << "   IPC\n";
+            for ( std::size_t phase = 0; phase < counts.size(); ++phase ) {
+                auto const& c = counts[ phase ];
+                std::cout << std::left << std::setw( 9 ) << kPhaseNames[ phase ] << std::right << std::setw( 9 )
+                          << c.nanoseconds / 1000000;
+                for ( std::size_t event = 0; event < c.events.size(); ++event ) {
+                    std::cout << " " << std::setw( 14 );
+                    if ( counters.available( static_cast< util::PerfEvent >( event ) ) )
+                        std::cout << c.events[ event ];
+                    else
+                        std::cout << "-";
+                }
+                std::cout << " ";
+                if ( counters.available( util::Cycles ) && counters.available( util::Instructions )
+                     && c.events[ util::Cycles ] > 0 )
+                    std::cout << std::fixed << std::setprecision( 2 ) << std::setw( 5 )
+                              << double( c.events[ util::Instructions ] ) / double( c.events[ util::Cycles ] )
+                              << std::defaultfloat;
+                else
+                    std::cout << "    -";
+                std::cout << "\n";
             }
+            if ( !counters.error().empty() )
+                std::cout << "Hardware counters unavailable (-): " << counters.error() << "\n";
+        }
+
+        // quiet: offset, size, distinct and cumulative distinct words per line
+        void printSegments( std::vector< Segment > const& segments ) {
+            if ( verbose_ && !segments.empty() )
+                std::cout << "Segments (offset, size, ~distinct words, ~cumulative distinct words):\n";
+            for ( auto const& segment : segments )
+                std::cout << segment.offset << " " << segment.size << " " << std::llround( segment.distinct ) << " "
+                          << std::llround( segment.cumulative ) << "\n";
+        }
+
+        // approximate numbers are rounded and marked by ~
+        static std::string formatCount( double count, bool exact ) {
+            std::string res = exact ? "" : "~";
+            return res.append( std::to_string( std::llround( count ) ) );
+        }
+
+        template< typename Engine, typename Aggregation, typename Delims >
+        int compareInputs() {
+            auto startTime = std::chrono::steady_clock::now();
+            if ( verbose_ ) {
+                std::cout << "================================================\n";
+                std::cout << "Comparing " << in_.string() << " with " << in2_.string() << "..." << std::endl;
+                std::cout << Aggregation::description << ", " << Engine::name << " engine, " << Engine::hashName << " hash"
+                          << std::endl;
+            }
+            auto res = compare< Engine, Aggregation, Delims >( in_, in2_, shortWords_, inBufSize_ );
+            if ( !verbose_ ) {
+                if ( setOperation_ == Diff )
+                    std::cout << formatCount( res.onlyFirst(), res.onlyFirstExact() ) << "\n";
+                else if ( setOperation_ == Intersect )
+                    std::cout << formatCount( res.common, res.commonExact ) << "\n";
+                else
+                    std::cout << ( res.jaccardExact() ? "" : "~" ) << res.jaccard() << "\n";
+                return 0;
+            }
+            std::chrono::duration< float > sec = std::chrono::steady_clock::now() - startTime;
+            std::cout << "!!! Done in " << sec.count() << " seconds.\n";
+            std::cout << "Unique words: " << formatCount( res.first, res.firstExact ) << " in " << in_.string() << ", "
+                      << formatCount( res.second, res.secondExact ) << " in " << in2_.string() << "\n";
+            std::cout << ( setOperation_ == Intersect ? "!!! " : "" )
+                      << "Common words: " << formatCount( res.common, res.commonExact ) << "\n";
+            std::cout << ( setOperation_ == Diff ? "!!! " : "" ) << "Only in " << in_.string() << ": "
+                      << formatCount( res.onlyFirst(), res.onlyFirstExact() ) << "\n";
+            std::cout << "Only in " << in2_.string() << ": " << formatCount( res.onlySecond(), res.onlySecondExact() )
+                      << "\n";
+            std::cout << ( setOperation_ == Jaccard ? "!!! " : "" ) << "Jaccard index: " << ( res.jaccardExact() ? "" : "~" )
+                      << res.jaccard() << "\n";
             return 0;
         }
 
@@ -482,10 +567,18 @@ namespace uwc {
                 usage();
                 return 1;
             }
-            if ( simple_ )
-                return countSimple();
-            else
-                return countUniqueWords();
+            if ( client_ ) {
+                auto response = requestCount( *client_, in_ );
+                if ( !response.starts_with( "OK " ) ) {
+                    std::cerr << "Error: " << response << "\n";
+                    return 1;
+                }
+                std::cout << response.substr( 3 ) << "\n";
+                return 0;
+            }
+            if ( spaceOnly_ )
+                return dispatch< util::SpaceDelimiters >();
+            return dispatch< util::WhitespaceDelimiters >();
         }
     };
 } // namespace uwc